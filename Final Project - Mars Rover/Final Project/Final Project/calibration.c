@@ -0,0 +1,272 @@
+/*
+ * calibration.c
+ *
+ * Calibration store and guided on-robot calibration routines. See calibration.h.
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include "util.h"
+#include "fixed_math.h"
+#include "calibration.h"
+#include "recorder.h"
+
+calibration cal_store;
+calibration EEMEM cal_eeprom;
+
+static uint8_t calibration_checksum(calibration* cal) {
+	uint8_t sum = 0;
+	uint8_t *bytes = (uint8_t *) cal;
+	
+	for (uint8_t i = 0; i < sizeof(calibration) - 1; i++)
+		sum += bytes[i];
+	
+	return sum;
+}
+
+void calibration_defaults(calibration* cal) {
+	cal->magic = CAL_MAGIC;
+	cal->servo_zero = ((16000000/(8 * 1000)) * 1) * 0.45;          // 1 ms pulse * 0.45 (0.4 for bot 3; 0.35 for bot 12; 0.59 for bot 11)
+	cal->servo_one_eighty = ((16000000/(8 * 1000)) * 2) * 1.0875; // 2 ms pulse * 1.0875 (1.0375 for bot 3 & 12; 1.185 for bot 11)
+	cal->ir_log2_coeff = 3824;    // log2(31427) * 256
+	cal->ir_exponent = 300;       // 1.171 * 256
+	cal->odo_distance_scale = 2327; // (1 / 0.11) * 256
+	cal->odo_angle_scale = 931;     // (1 / 1.1) * 1024
+	cal->checksum = calibration_checksum(cal);
+}
+
+void calibration_load(void) {
+	rec_idle(); // Not while the flight recorder is writing
+	eeprom_read_block(&cal_store, &cal_eeprom, sizeof(calibration));
+	
+	if (cal_store.magic != CAL_MAGIC || cal_store.checksum != calibration_checksum(&cal_store))
+		calibration_defaults(&cal_store);
+}
+
+void calibration_save(void) {
+	cal_store.magic = CAL_MAGIC;
+	cal_store.checksum = calibration_checksum(&cal_store);
+	rec_idle(); // Not while the flight recorder is writing
+	eeprom_update_block(&cal_store, &cal_eeprom, sizeof(calibration));
+}
+
+/* Averages a few SONAR readings. Returns the distance in mm. */
+static uint16_t read_sonar_mm(void) {
+	float sum = 0;
+	
+	for (char i = 0; i < 4; i++) {
+		send_pulse();
+		wait_ms(50); // Let the echo come back
+		sum += read_PING_distance();
+	}
+	
+	return sum * 10 / 4;
+}
+
+/* Sweeps the servo around an expected pulse width and returns the pulse width at the center of the closest IR return, or 0 if nothing was seen. */
+static uint16_t find_target_pulse(uint16_t expected) {
+	uint16_t step = (cal_store.servo_one_eighty - cal_store.servo_zero) / 180; // About one degree
+	uint16_t low = (expected > (CAL_SERVO_WINDOW + 1) * step) ? expected - CAL_SERVO_WINDOW * step : step;
+	uint16_t high = expected + CAL_SERVO_WINDOW * step;
+	int distances[2 * CAL_SERVO_WINDOW + 1];
+	int closest = 80; // Ignore anything further than 80 cm
+	uint8_t n = 0;
+	
+	servo_set_pulse(low);
+	wait_ms(500); // Wait for servo to get into position
+	
+	for (uint16_t pulse = low; pulse <= high && n < sizeof(distances) / sizeof(distances[0]); pulse += step) {
+		servo_set_pulse(pulse);
+		wait_ms(20);
+		distances[n] = read_IR_distance();
+		if (distances[n] < closest)
+			closest = distances[n];
+		n++;
+	}
+	
+	if (closest >= 80)
+		return 0;
+	
+	/* Center of every sample within 2 cm of the closest one */
+	uint32_t sum = 0;
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < n; i++) {
+		if (distances[i] <= closest + 2) {
+			sum += low + i * step;
+			count++;
+		}
+	}
+	
+	return sum / count;
+}
+
+char calibrate_servo(void) {
+	char buffer[60];
+	uint16_t zero, one_eighty;
+	
+	send_message_P(PSTR("\r\nPlace a narrow target 30 cm away at 0 degrees (right side) and press a key.\r\n"));
+	USART_Receive();
+	zero = find_target_pulse(cal_store.servo_zero);
+	
+	send_message_P(PSTR("\r\nPlace the target 30 cm away at 180 degrees (left side) and press a key.\r\n"));
+	USART_Receive();
+	one_eighty = find_target_pulse(cal_store.servo_one_eighty);
+	
+	if (zero == 0 || one_eighty <= zero + 180) {
+		send_message_P(PSTR("\r\nServo calibration failed: target not found.\r\n"));
+		return 0;
+	}
+	
+	cal_store.servo_zero = zero;
+	cal_store.servo_one_eighty = one_eighty;
+	
+	sprintf_P(buffer, PSTR("\r\nServo: 0 deg = %u, 180 deg = %u\r\n"), zero, one_eighty);
+	send_message(buffer);
+	return 1;
+}
+
+char calibrate_ir(void) {
+	char buffer[60];
+	int16_t log_adc[CAL_IR_MAX_POINTS];
+	int16_t log_dist[CAL_IR_MAX_POINTS];
+	uint8_t n = 0;
+	float degrees = 90;
+	
+	move_servo(&degrees); // Point sensors straight ahead
+	wait_ms(500);
+	
+	send_message_P(PSTR("\r\nPlace a flat target in front of the sensors (10-80 cm) and press a key. Press 'x' when done.\r\n"));
+	
+	while (n < CAL_IR_MAX_POINTS && USART_Receive() != 'x') {
+		unsigned int adc = read_IR_raw();
+		uint16_t sonar = read_sonar_mm();
+		
+		if (adc == 0 || sonar < 50) { // Nothing usable in front of the sensors
+			send_message_P(PSTR("No reading, try again.\r\n"));
+			continue;
+		}
+		
+		log_adc[n] = fx_log2(adc);
+		log_dist[n] = fx_log2(sonar) - fx_log2(10); // log2 of distance in cm
+		n++;
+		
+		sprintf_P(buffer, PSTR("Point %d: ADC %u, SONAR %u mm\r\n"), n, adc, sonar);
+		send_message(buffer);
+	}
+	
+	if (n < 3) {
+		send_message_P(PSTR("\r\nIR calibration failed: need at least 3 points.\r\n"));
+		return 0;
+	}
+	
+	/* Least squares fit of log2(distance) = log2(K) - p * log2(ADC) */
+	int32_t sum_x = 0, sum_y = 0;
+	for (uint8_t i = 0; i < n; i++) {
+		sum_x += log_adc[i];
+		sum_y += log_dist[i];
+	}
+	
+	int16_t mean_x = sum_x / n;
+	int16_t mean_y = sum_y / n;
+	int32_t sxx = 0, sxy = 0;
+	for (uint8_t i = 0; i < n; i++) {
+		int32_t dx = log_adc[i] - mean_x;
+		sxx += dx * dx;
+		sxy += dx * (log_dist[i] - mean_y);
+	}
+	
+	if (sxx == 0 || sxy >= 0) { // All points at one distance, or the curve does not fall off
+		send_message_P(PSTR("\r\nIR calibration failed: spread the points out.\r\n"));
+		return 0;
+	}
+	
+	int32_t exponent = ((int64_t) -sxy * 256) / sxx; // Q8
+	cal_store.ir_exponent = exponent;
+	cal_store.ir_log2_coeff = mean_y + ((exponent * mean_x) >> 8);
+	
+	sprintf_P(buffer, PSTR("\r\nIR: log2(K) = %d/256, p = %u/256\r\n"), cal_store.ir_log2_coeff, cal_store.ir_exponent);
+	send_message(buffer);
+	return 1;
+}
+
+char calibrate_odometry(oi_t *self) {
+	char buffer[60];
+	int32_t turned = 0;
+	int32_t driven = 0;
+	float degrees = 90;
+	
+	/* Rotation */
+	send_message_P(PSTR("\r\nMark the robot's heading and press a key to start turning. Press a key again after exactly one full turn.\r\n"));
+	USART_Receive();
+	oi_update(self); // Clear angle
+	oi_set_wheels(50, -50);
+	while (!USART_Available()) {
+		oi_update(self);
+		turned += self->angle;
+	}
+	USART_Receive();
+	oi_set_wheels(0, 0);
+	oi_update(self);
+	turned += self->angle;
+	
+	if (turned < 180) {
+		send_message_P(PSTR("\r\nOdometry calibration failed: the robot did not turn.\r\n"));
+		return 0;
+	}
+	
+	/* Distance */
+	move_servo(&degrees); // Point sensors straight ahead
+	send_message_P(PSTR("\r\nFace a wall 100-200 cm away and press a key.\r\n"));
+	USART_Receive();
+	uint16_t start = read_sonar_mm();
+	int32_t togo = ((int32_t) CAL_ODO_DRIVE_CM * cal_store.odo_distance_scale) >> 8;
+	
+	oi_update(self); // Clear distance
+	oi_set_wheels(150, 150);
+	while (driven < togo) {
+		oi_update(self);
+		driven += self->distance;
+	}
+	oi_set_wheels(0, 0);
+	oi_update(self);
+	driven += self->distance;
+	uint16_t end = read_sonar_mm();
+	
+	if (end + 100 > start) { // Less than 10 cm of change is not enough to measure
+		send_message_P(PSTR("\r\nOdometry calibration failed: wall not seen.\r\n"));
+		return 0;
+	}
+	
+	cal_store.odo_angle_scale = (turned * 1024) / 360;
+	cal_store.odo_distance_scale = (driven * 2560) / (start - end); // sensor mm per true cm, Q8
+	
+	sprintf_P(buffer, PSTR("\r\nOdometry: distance %u/256, angle %u/1024\r\n"), cal_store.odo_distance_scale, cal_store.odo_angle_scale);
+	send_message(buffer);
+	return 1;
+}
+
+void calibration_menu(oi_t *self) {
+	char ok = 0;
+	
+	send_message_P(PSTR("\r\nCalibrate: (s)ervo, (i)r, (o)dometry, (d)efaults\r\n"));
+	
+	char choice = USART_Receive();
+	
+	if (choice == 's') {
+		ok = calibrate_servo();
+	} else if (choice == 'i') {
+		ok = calibrate_ir();
+	} else if (choice == 'o') {
+		ok = calibrate_odometry(self);
+	} else if (choice == 'd') {
+		calibration_defaults(&cal_store);
+		ok = 1;
+	}
+	
+	if (ok) {
+		calibration_save();
+		send_message_P(PSTR("Calibration saved.\r\n"));
+	}
+}
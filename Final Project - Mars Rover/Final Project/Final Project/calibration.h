@@ -0,0 +1,91 @@
+/*! \file calibration.h
+    \brief Calibration store and guided on-robot calibration routines.
+	
+	Every robot reads its sensors and wheels a little differently. Instead of hand-tuning multipliers
+	in util.c and main.c, the values below are fitted on the robot and kept in EEPROM.
+*/
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+
+/*! \def CAL_MAGIC
+	\brief Marks a valid calibration record in EEPROM. Bump when the calibration struct changes.
+*/
+#define CAL_MAGIC 0x2881
+/*! \def CAL_IR_MAX_POINTS
+	\brief Maximum number of target distances sampled when fitting the IR curve
+*/
+#define CAL_IR_MAX_POINTS 12
+/*! \def CAL_SERVO_WINDOW
+	\brief Number of degrees searched on each side of the expected target position during servo calibration
+*/
+#define CAL_SERVO_WINDOW 20
+/*! \def CAL_ODO_DRIVE_CM
+	\brief Distance (in cm) driven towards a wall during odometry calibration
+*/
+#define CAL_ODO_DRIVE_CM 50
+
+//! Calibration values for one robot.
+/*! Scale factors are stored in fixed point so they can be fitted without floating point math. */
+typedef struct {
+	uint16_t magic; /*!< CAL_MAGIC when the record is valid. */
+	uint16_t servo_zero; /*!< Servo pulse width (OCR3B counts) that points the sensors at 0 degrees. Replaces ZERO. */
+	uint16_t servo_one_eighty; /*!< Servo pulse width (OCR3B counts) that points the sensors at 180 degrees. Replaces ONE_EIGHTY. */
+	int16_t ir_log2_coeff; /*!< log2(K) in Q8 for the IR power curve distance = K * ADC^-p (in cm). */
+	uint16_t ir_exponent; /*!< p in Q8 for the IR power curve distance = K * ADC^-p. */
+	uint16_t odo_distance_scale; /*!< Create distance sensor millimeters per centimeter actually traveled, in Q8. Replaces the 0.11 factor in move(). */
+	uint16_t odo_angle_scale; /*!< Create angle sensor degrees per degree actually turned, in Q10. Replaces the 1.1 factor in rotate(). */
+	uint8_t checksum; /*!< Sum of all preceding bytes. */
+} calibration;
+
+/// The calibration values in use. Loaded from EEPROM by calibration_load().
+extern calibration cal_store;
+
+/// Fills in the hand-tuned values for bot 17.
+/**
+* @param cal the calibration record to fill in
+*/
+void calibration_defaults(calibration* cal);
+
+/// Loads cal_store from EEPROM.
+/**
+* Falls back to calibration_defaults() if the EEPROM record is missing or corrupt. Must be called before the servo or IR sensor is used.
+*/
+void calibration_load(void);
+
+/// Writes cal_store to EEPROM.
+void calibration_save(void);
+
+/// Fits the servo end points against a target.
+/**
+* The operator places a narrow target at 0 degrees and then at 180 degrees. For each, the servo sweeps its pulse width around the expected position and the center of the closest IR return is taken as the new end point.
+* @return 1 if the fit succeeded and cal_store was updated, 0 otherwise
+*/
+char calibrate_servo(void);
+
+/// Fits the IR power curve against the SONAR sensor.
+/**
+* The operator places a flat target in front of the sensors at a number of distances. The raw IR ADC value and SONAR distance are recorded at each and a least squares line is fitted in log-log space.
+* @return 1 if the fit succeeded and cal_store was updated, 0 otherwise
+*/
+char calibrate_ir(void);
+
+/// Fits the odometry scale factors.
+/**
+* Performs an in-place rotation that the operator stops after exactly 360 degrees, then drives CAL_ODO_DRIVE_CM towards a wall, using the SONAR sensor to measure the true distance traveled.
+* @param self a structure storing the iRobot Create's sensor data.
+* @return 1 if the fit succeeded and cal_store was updated, 0 otherwise
+*/
+char calibrate_odometry(oi_t *self);
+
+/// Lets the operator choose a calibration routine over bluetooth and saves the result.
+/**
+* 's' calibrates the servo, 'i' the IR sensor, 'o' the odometry, and 'd' restores the defaults. Any other key leaves the calibration unchanged.
+* @param self a structure storing the iRobot Create's sensor data.
+*/
+void calibration_menu(oi_t *self);
+
+#endif
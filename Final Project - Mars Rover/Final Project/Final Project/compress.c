@@ -0,0 +1,53 @@
+/*
+ * compress.c
+ *
+ * Streaming series encoder. See compress.h.
+ */
+
+#include "compress.h"
+
+void comp_series_begin(comp_series* s, comp_sink sink, void* context) {
+	s->sink = sink;
+	s->context = context;
+	s->previous = 0;
+	s->run = 0;
+}
+
+static void series_flush_run(comp_series* s) {
+	if (s->run == 1) { // A single unchanged reading is a zero delta
+		s->sink(0, s->context);
+	} else if (s->run > 1) {
+		s->sink(COMP_RUN + s->run - 1, s->context);
+	}
+	s->run = 0;
+}
+
+void comp_series_put(comp_series* s, uint16_t value) {
+	int16_t delta = value - s->previous;
+	uint16_t zigzag = ((uint16_t) delta << 1) ^ (uint16_t) (delta >> 15); // Small changes either way become small numbers
+	
+	s->previous = value;
+	
+	if (zigzag == 0) {
+		if (++s->run == COMP_RUN_MAX)
+			series_flush_run(s);
+		return;
+	}
+	
+	series_flush_run(s);
+	
+	if (zigzag < COMP_RUN) {
+		s->sink(zigzag, s->context);
+	} else if (zigzag < ((uint16_t) (COMP_FULL - COMP_WIDE) << 8)) {
+		s->sink(COMP_WIDE | (zigzag >> 8), s->context);
+		s->sink(zigzag, s->context);
+	} else {
+		s->sink(COMP_FULL, s->context);
+		s->sink(zigzag, s->context);
+		s->sink(zigzag >> 8, s->context);
+	}
+}
+
+void comp_series_end(comp_series* s) {
+	series_flush_run(s);
+}
@@ -0,0 +1,57 @@
+/*! \file compress.h
+    \brief Small streaming compressor for data sent over bluetooth.
+	
+	Series of 16-bit readings (like one field of a sweep) are sent as zig-zag deltas with runs of
+	unchanged readings collapsed. The encoder works one value at a time, hands each output byte to a
+	sink function, and keeps only a few bytes of state. host/decode.c has the matching decoder.
+	
+	Series bytes:
+	0x00-0x7F  zig-zag delta 0 to 127 (change of -64 to +63)
+	0x80-0xBF  (byte - 0x80 + 1) readings unchanged
+	0xC0-0xFE  zig-zag delta ((byte & 0x3F) << 8) + next byte
+	0xFF       zig-zag delta in the next two bytes, little endian
+*/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <inttypes.h>
+
+/*! \def COMP_RUN
+	\brief First series byte that is a run of unchanged readings
+*/
+#define COMP_RUN 0x80
+/*! \def COMP_RUN_MAX
+	\brief Longest run one series byte holds
+*/
+#define COMP_RUN_MAX 64
+/*! \def COMP_WIDE
+	\brief First series byte of a two byte delta
+*/
+#define COMP_WIDE 0xC0
+/*! \def COMP_FULL
+	\brief Series byte followed by a full 16-bit delta
+*/
+#define COMP_FULL 0xFF
+
+/// Receives each compressed byte.
+typedef void (*comp_sink)(uint8_t data, void* context);
+
+//! State of a series encoder.
+typedef struct {
+	comp_sink sink;    /*!< Where output bytes go */
+	void* context;     /*!< Passed to sink */
+	uint16_t previous; /*!< Last reading. The first delta is taken from 0. */
+	uint8_t run;       /*!< Unchanged readings not sent yet */
+} comp_series;
+
+/// Starts a series.
+void comp_series_begin(comp_series* s, comp_sink sink, void* context);
+
+/// Adds a reading to a series.
+void comp_series_put(comp_series* s, uint16_t value);
+
+/// Sends whatever the series is still holding. Call after the last reading.
+void comp_series_end(comp_series* s);
+
+#endif
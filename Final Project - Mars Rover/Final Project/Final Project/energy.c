@@ -0,0 +1,136 @@
+/*
+ * energy.c
+ *
+ * Battery monitor and energy budget. See energy.h.
+ */
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#include "util.h"
+#include "energy.h"
+
+static int16_t history[ENERGY_HISTORY]; // Average mA drawn in each of the last seconds, oldest overwritten first
+static uint8_t history_count, history_next;
+static int32_t second_sum;              // mA drawn, summed over the frames of the second being averaged
+static uint8_t second_frames;
+static unsigned long second_start;      // oi_frame_time() the second started at
+static char known;                      // Has a frame with the battery in it arrived?
+static uint16_t charge, capacity, voltage;
+static int16_t current;
+static uint8_t state;
+static char disarmed;                   // Docking was cancelled; not due again until the charge is above the reserve
+
+/* Charge in mAh held back to get to the dock */
+static uint16_t reserve(void) {
+	return (uint32_t) capacity * ENERGY_DOCK_PERCENT / 100;
+}
+
+static char on_dock(oi_t* self) {
+	return self->home_base_charger_on || (self->charging_state != OI_CHARGING_NONE && self->charging_state != OI_CHARGING_FAULT);
+}
+
+void energy_update(oi_t* self) {
+	unsigned long now = oi_frame_time();
+
+	if (self->capacity == 0) // No battery in the frame
+		return;
+	if (!known) {
+		known = 1;
+		second_start = now;
+	}
+	charge = self->charge;
+	capacity = self->capacity;
+	voltage = self->voltage;
+	current = self->current;
+
+	second_sum -= current; // The Create reports discharge as negative
+	second_frames++;
+	if (now - second_start >= 250000UL) { // 250000 ticks per second
+		history[history_next] = second_sum / second_frames;
+		history_next = (history_next + 1) % ENERGY_HISTORY;
+		if (history_count < ENERGY_HISTORY)
+			history_count++;
+		second_sum = 0;
+		second_frames = 0;
+		second_start = now;
+	}
+
+	if (charge > reserve())
+		disarmed = 0;
+	if (state == ENERGY_OK && charge <= reserve() && !disarmed)
+		state = ENERGY_DOCK_DUE;
+	else if (state == ENERGY_DOCKING && on_dock(self))
+		state = ENERGY_DOCKED;
+	else if (state == ENERGY_DOCKED && !on_dock(self)) // Taken off the dock
+		state = (charge <= reserve()) ? ENERGY_DOCK_DUE : ENERGY_OK;
+}
+
+uint8_t energy_state(void) {
+	return state;
+}
+
+long energy_runtime(void) {
+	int32_t draw = 0;
+
+	if (!known || history_count == 0)
+		return -1;
+	for (uint8_t i = 0; i < history_count; i++)
+		draw += history[i];
+	draw /= history_count;
+	if (draw <= 0) // Charging
+		return -1;
+	if (charge <= reserve())
+		return 0;
+	return (uint32_t) (charge - reserve()) * 3600 / draw;
+}
+
+int16_t energy_speed(int16_t speed) {
+	long runtime = energy_runtime();
+
+	if (runtime < 0 || runtime >= ENERGY_RUNTIME_FULL)
+		return speed;
+	return (int32_t) speed * (ENERGY_MIN_SPEED + (100 - ENERGY_MIN_SPEED) * runtime / ENERGY_RUNTIME_FULL) / 100;
+}
+
+uint8_t energy_scan_step(void) {
+	long runtime = energy_runtime();
+
+	if (runtime < 0 || runtime >= ENERGY_RUNTIME_SPARSE)
+		return 1;
+	return (runtime >= ENERGY_RUNTIME_SPARSE / 2) ? 2 : 3;
+}
+
+void energy_dock(void) {
+	go_charge();
+	state = ENERGY_DOCKING;
+}
+
+void energy_cancel_dock(void) {
+	oi_tx_begin();
+	oi_byte_tx(OI_OPCODE_FULL);
+	oi_tx_end();
+	state = ENERGY_OK;
+	disarmed = 1;
+}
+
+void energy_report(void) {
+	static const char states[][9] PROGMEM = {"running", "dock due", "docking", "docked"};
+	char buffer[100];
+	char name[9];
+	long runtime = energy_runtime();
+
+	if (!known) {
+		send_message_P(PSTR("\r\nBattery: not heard from yet\r\n"));
+		return;
+	}
+	strcpy_P(name, states[state]);
+	sprintf_P(buffer, PSTR("\r\nBattery: %u of %u mAh, %u mV, %d mA, %s\r\n"), charge, capacity, voltage, current, name);
+	send_message(buffer);
+	if (history_count == 0)
+		sprintf_P(buffer, PSTR("Runtime: still measuring the draw\r\n"));
+	else if (runtime < 0)
+		sprintf_P(buffer, PSTR("Runtime: not draining\r\n"));
+	else
+		sprintf_P(buffer, PSTR("Runtime: %ld s above the %u mAh reserve, speed %d%%, sweep every %u degrees\r\n"), runtime, reserve(), energy_speed(100), energy_scan_step());
+	send_message(buffer);
+}
@@ -0,0 +1,113 @@
+/*! \file energy.h
+    \brief Battery monitor and energy budget.
+
+	Every sensor frame carries the battery's charge, capacity, and current. The current is averaged
+	over each second, and the last ENERGY_HISTORY averages give the draw the remaining runtime is
+	estimated from: the charge above the dock reserve (ENERGY_DOCK_PERCENT of the capacity) divided
+	by that draw.
+
+	The runtime left sets how hard the robot works. Below ENERGY_RUNTIME_FULL seconds the cruise
+	speed drops towards ENERGY_MIN_SPEED, which keeps the current down and the voltage from sagging,
+	and below ENERGY_RUNTIME_SPARSE seconds sweeps sample every second or third degree instead of
+	every degree. Once the charge falls to the reserve, the dock is due: move() stops at the next
+	sensor frame, sequences and exploration stop after their current step, scripted moves don't
+	start (one already running finishes, since the Create ignores commands while it runs), and
+	energy_dock() sends the Create to look for its home base on its own, without waiting for it.
+	While the robot waits for a command, it wakes every ENERGY_POLL_MS to read a frame, so the dock
+	comes due even if the operator sends nothing.
+	Until the battery has been heard from, the robot runs at full speed and density.
+*/
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+
+/*! \def ENERGY_HISTORY
+	\brief Seconds of current draw the runtime estimate averages
+*/
+#define ENERGY_HISTORY 16
+/*! \def ENERGY_DOCK_PERCENT
+	\brief Charge kept in reserve to get back to the dock, in percent of the capacity
+*/
+#define ENERGY_DOCK_PERCENT 15
+/*! \def ENERGY_RUNTIME_FULL
+	\brief Runtime above the reserve, in seconds, below which the cruise speed is scaled down
+*/
+#define ENERGY_RUNTIME_FULL 1800
+/*! \def ENERGY_RUNTIME_SPARSE
+	\brief Runtime above the reserve, in seconds, below which sweeps skip degrees
+*/
+#define ENERGY_RUNTIME_SPARSE 600
+/*! \def ENERGY_MIN_SPEED
+	\brief Slowest cruise speed, in percent of the full one
+*/
+#define ENERGY_MIN_SPEED 60
+
+/*! \def ENERGY_POLL_MS
+	\brief Longest the battery goes unwatched while the robot waits for a command, in ms
+*/
+#define ENERGY_POLL_MS 250
+
+/*! \def ENERGY_OK
+	\brief Charge above the reserve
+*/
+#define ENERGY_OK 0
+/*! \def ENERGY_DOCK_DUE
+	\brief Charge at the reserve; the robot should head for the dock
+*/
+#define ENERGY_DOCK_DUE 1
+/*! \def ENERGY_DOCKING
+	\brief The Create is looking for its home base
+*/
+#define ENERGY_DOCKING 2
+/*! \def ENERGY_DOCKED
+	\brief The Create is on its home base and charging
+*/
+#define ENERGY_DOCKED 3
+
+/// Adds a sensor frame. oi_update() calls it for every frame.
+void energy_update(oi_t* self);
+
+/// Where the robot is with respect to the dock.
+/**
+* @return ENERGY_OK, ENERGY_DOCK_DUE, ENERGY_DOCKING, or ENERGY_DOCKED
+*/
+uint8_t energy_state(void);
+
+/// Estimated time the battery lasts at the recent draw before it reaches the dock reserve.
+/**
+* @return seconds, 0 at or below the reserve, or -1 if the battery hasn't been heard from or isn't draining
+*/
+long energy_runtime(void);
+
+/// Scales a cruise speed to the energy budget.
+/**
+* @param speed full speed in mm/s, either sign
+* @return speed scaled down to as little as ENERGY_MIN_SPEED percent of it
+*/
+int16_t energy_speed(int16_t speed);
+
+/// Degrees between the sweep's samples that the energy budget allows.
+/**
+* @return 1, 2, or 3
+*/
+uint8_t energy_scan_step(void);
+
+/// Sends the Create to look for its home base and returns at once.
+/**
+* The Create leaves Full mode while it docks. energy_update() watches the frames' charging state for the end.
+*/
+void energy_dock(void);
+
+/// Takes the Create back from docking so the operator can drive it.
+/**
+* The dock isn't due again until the charge has been above the reserve.
+*/
+void energy_cancel_dock(void);
+
+/// Sends the charge, draw, runtime estimate, and dock state over bluetooth.
+void energy_report(void);
+
+#endif
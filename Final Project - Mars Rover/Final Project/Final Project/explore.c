@@ -0,0 +1,183 @@
+/*
+ * explore.c
+ *
+ * Exploration map and frontier search. See explore.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "util.h"
+#include "scan.h"
+#include "sensor_fusion.h"
+#include "geometry.h"
+#include "explore.h"
+
+static uint8_t map[(EXPLORE_SIZE * EXPLORE_SIZE + 3) / 4]; // 2 bits per cell, row by row from the south west corner
+static char goal_found;         // Has the robot crossed the red tape?
+static float goal_x, goal_y;    // Where it did, in cm
+
+/* Finds the cell a point is in. Returns 0 if it is off the map. */
+static char cell_of(float x, float y, uint8_t* col, uint8_t* row) {
+	int c = floor(x / EXPLORE_CELL) + EXPLORE_SIZE / 2;
+	int r = floor(y / EXPLORE_CELL) + EXPLORE_SIZE / 2;
+
+	if (c < 0 || c >= EXPLORE_SIZE || r < 0 || r >= EXPLORE_SIZE)
+		return 0;
+	*col = c;
+	*row = r;
+	return 1;
+}
+
+static uint8_t get(uint8_t col, uint8_t row) {
+	uint16_t i = row * EXPLORE_SIZE + col;
+	return (map[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+static void set(uint8_t col, uint8_t row, uint8_t state) {
+	uint16_t i = row * EXPLORE_SIZE + col;
+	uint8_t shift = (i & 3) * 2;
+	map[i >> 2] = (map[i >> 2] & ~(3 << shift)) | (state << shift);
+}
+
+/* Free never overwrites blocked, so one clear ray can't erase an object another ray hit */
+static void mark(float x, float y, uint8_t state) {
+	uint8_t col, row;
+
+	if (!cell_of(x, y, &col, &row))
+		return;
+	if (state == EXPLORE_FREE && get(col, row) == EXPLORE_BLOCKED)
+		return;
+	set(col, row, state);
+}
+
+/* Is nothing blocked on the straight line between two points? */
+static char clear_line(float x0, float y0, float x1, float y1) {
+	float dx = x1 - x0, dy = y1 - y0;
+	int steps = sqrt(dx * dx + dy * dy) / (EXPLORE_CELL / 2) + 1;
+
+	for (int i = 1; i <= steps; i++) {
+		if (explore_cell(x0 + dx * i / steps, y0 + dy * i / steps) == EXPLORE_BLOCKED)
+			return 0;
+	}
+	return 1;
+}
+
+void explore_reset(void) {
+	memset(map, 0, sizeof(map));
+}
+
+uint8_t explore_cell(float x, float y) {
+	uint8_t col, row;
+
+	if (!cell_of(x, y, &col, &row))
+		return EXPLORE_BLOCKED;
+	return get(col, row);
+}
+
+void explore_mark_sweep(robot* bot) {
+	for (int angle = 0; angle < SCAN_SAMPLES; angle += EXPLORE_RAY_STEP) {
+		int range;
+		char hit = fuse_range(scan_data[angle].ir_cm, scan_sonar_cm(scan_data[angle].sonar_ticks), &range) > 0 && range < MAX_DETECTION_DISTANCE;
+		int reach = hit ? range : MAX_DETECTION_DISTANCE; // Nothing in range means clear as far as the sensors see
+		uint16_t bearing = GEO_DEGREES(bot->angle - 90) + GEO_DEGREES(angle); // Same bearing as find_objs_IR()
+
+		for (int d = 0; d < reach - EXPLORE_CELL / 2; d += EXPLORE_CELL / 2) {
+			float x = bot->x, y = bot->y;
+			geo_project(&x, &y, d, bearing);
+			mark(x, y, EXPLORE_FREE);
+		}
+		if (hit) {
+			float x = bot->x, y = bot->y;
+			geo_project(&x, &y, range, bearing);
+			mark(x, y, EXPLORE_BLOCKED);
+		}
+	}
+}
+
+void explore_mark_objects(obstacle* obst) {
+	for (int i = 0; i < obst->all_object_index; i++) {
+		if (obst->object_kind[i] == RED) // The goal, not something to avoid
+			continue;
+		mark(obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y], EXPLORE_BLOCKED);
+	}
+}
+
+void explore_mark_path(float x0, float y0, float x1, float y1) {
+	float dx = x1 - x0, dy = y1 - y0;
+	int steps = sqrt(dx * dx + dy * dy) / (EXPLORE_CELL / 2) + 1;
+
+	for (int i = 0; i <= steps; i++)
+		mark(x0 + dx * i / steps, y0 + dy * i / steps, EXPLORE_FREE);
+}
+
+void explore_give_up(float x, float y) {
+	uint8_t col, row;
+
+	if (cell_of(x, y, &col, &row))
+		set(col, row, EXPLORE_BLOCKED);
+}
+
+char explore_frontier(robot* bot, float* x, float* y) {
+	float best = -1;
+
+	for (uint8_t row = 0; row < EXPLORE_SIZE; row++) {
+		for (uint8_t col = 0; col < EXPLORE_SIZE; col++) {
+			if (get(col, row) != EXPLORE_FREE)
+				continue;
+			if (!((col > 0 && get(col - 1, row) == EXPLORE_UNKNOWN) || (col < EXPLORE_SIZE - 1 && get(col + 1, row) == EXPLORE_UNKNOWN) ||
+			      (row > 0 && get(col, row - 1) == EXPLORE_UNKNOWN) || (row < EXPLORE_SIZE - 1 && get(col, row + 1) == EXPLORE_UNKNOWN)))
+				continue; // Not next to anything unknown
+
+			float cx = (col - EXPLORE_SIZE / 2 + 0.5) * EXPLORE_CELL;
+			float cy = (row - EXPLORE_SIZE / 2 + 0.5) * EXPLORE_CELL;
+			float dx = cx - bot->x, dy = cy - bot->y;
+			float distance = dx * dx + dy * dy;
+
+			if (distance < EXPLORE_CELL * EXPLORE_CELL) // The cell the robot is in
+				continue;
+			if (best >= 0 && distance >= best)
+				continue;
+			if (!clear_line(bot->x, bot->y, cx, cy)) // Only checked for cells that would be the new best
+				continue;
+
+			best = distance;
+			*x = cx;
+			*y = cy;
+		}
+	}
+
+	return best >= 0;
+}
+
+void explore_found_goal(float x, float y) {
+	goal_found = 1;
+	goal_x = x;
+	goal_y = y;
+}
+
+char explore_goal(float* x, float* y) {
+	if (!goal_found)
+		return 0;
+	*x = goal_x;
+	*y = goal_y;
+	return 1;
+}
+
+void explore_send_map(robot* bot) {
+	static const char symbols[] PROGMEM = " .#";
+	char line[EXPLORE_SIZE + 3];
+	uint8_t robot_col = 0xFF, robot_row = 0xFF;
+
+	cell_of(bot->x, bot->y, &robot_col, &robot_row);
+
+	send_message_P(PSTR("\r\n"));
+	for (int row = EXPLORE_SIZE - 1; row >= 0; row--) {
+		for (uint8_t col = 0; col < EXPLORE_SIZE; col++)
+			line[col] = (col == robot_col && row == robot_row) ? 'R' : pgm_read_byte(&symbols[get(col, row)]);
+		line[EXPLORE_SIZE] = '\r';
+		line[EXPLORE_SIZE + 1] = '\n';
+		line[EXPLORE_SIZE + 2] = 0;
+		send_message(line);
+	}
+}
@@ -0,0 +1,108 @@
+/*! \file explore.h
+    \brief Coarse map of the field for autonomous exploration.
+
+	The field around the starting point is split into EXPLORE_SIZE by EXPLORE_SIZE cells of
+	EXPLORE_CELL cm. Each cell is unknown, free, or blocked. Sweeps clear the cells along every
+	ray up to what the ray hit, and block the cell it hit; tracked objects and the hazards logged by
+	log_position() block their cells; cells the robot drives through are free.
+
+	A frontier is a free cell next to an unknown one. Exploring means driving to the nearest
+	frontier the robot can see in a straight line, sweeping, and repeating until the robot has
+	crossed the retrieval zone (red tape) or there are no frontiers left.
+*/
+
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <inttypes.h>
+#include "object_tracking.h"
+
+/*! \def EXPLORE_CELL
+	\brief Width of a map cell in cm
+*/
+#define EXPLORE_CELL 20
+/*! \def EXPLORE_SIZE
+	\brief Cells along each side of the map. The starting point is in the middle.
+*/
+#define EXPLORE_SIZE 24
+/*! \def EXPLORE_RAY_STEP
+	\brief Degrees between the sweep rays used to clear the map
+*/
+#define EXPLORE_RAY_STEP 3
+/*! \def EXPLORE_STEP
+	\brief Longest leg driven towards a frontier before sweeping again, in cm
+*/
+#define EXPLORE_STEP 40
+/*! \def EXPLORE_BUDGET
+	\brief Longest time an exploration runs, in seconds
+*/
+#define EXPLORE_BUDGET 300
+
+/*! \def EXPLORE_UNKNOWN
+	\brief Cell not seen yet
+*/
+#define EXPLORE_UNKNOWN 0
+/*! \def EXPLORE_FREE
+	\brief Cell seen to be empty
+*/
+#define EXPLORE_FREE 1
+/*! \def EXPLORE_BLOCKED
+	\brief Cell with an object or hazard in it, or a frontier the robot could not get to
+*/
+#define EXPLORE_BLOCKED 2
+
+/// Forgets the map.
+void explore_reset(void);
+
+/// State of the cell a point is in.
+/**
+* @param x in cm
+* @param y in cm
+* @return EXPLORE_UNKNOWN, EXPLORE_FREE, or EXPLORE_BLOCKED. Points off the map are blocked.
+*/
+uint8_t explore_cell(float x, float y);
+
+/// Adds the sweep in scan_data, taken from the robot's current pose.
+void explore_mark_sweep(robot* bot);
+
+/// Blocks the cells of every tracked object and hazard.
+void explore_mark_objects(obstacle* obst);
+
+/// Frees the cells along a stretch the robot drove.
+void explore_mark_path(float x0, float y0, float x1, float y1);
+
+/// Blocks a frontier the robot could not get to, so it isn't picked again.
+void explore_give_up(float x, float y);
+
+/// Finds the nearest frontier in a straight line from the robot with nothing blocked on the way.
+/**
+* @param bot the robot's pose
+* @param x set to the middle of the frontier cell, in cm
+* @param y set to the middle of the frontier cell, in cm
+* @return 1, or 0 if there is none left
+*/
+char explore_frontier(robot* bot, float* x, float* y);
+
+/// Remembers where the robot crossed the retrieval zone. move() calls it when a cliff sensor enters red tape.
+/**
+* Kept apart from the tracked objects, so the goal is still found when there is no room left to track it.
+* @param x where the robot was, in cm
+* @param y where the robot was, in cm
+*/
+void explore_found_goal(float x, float y);
+
+/// Tells whether the robot has crossed the retrieval zone.
+/**
+* @param x set to where the red tape was crossed, in cm
+* @param y set to where the red tape was crossed, in cm
+* @return 1 if it has been found
+*/
+char explore_goal(float* x, float* y);
+
+/// Sends the map over bluetooth, one text row per row of cells, north at the top.
+/**
+* ' ' is unknown, '.' free, '#' blocked, and 'R' the robot.
+*/
+void explore_send_map(robot* bot);
+
+#endif
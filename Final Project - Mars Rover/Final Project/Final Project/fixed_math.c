@@ -0,0 +1,59 @@
+/*
+ * fixed_math.c
+ *
+ * Fixed point math helpers. See fixed_math.h.
+ */
+
+#include "fixed_math.h"
+
+int16_t fx_log2(uint16_t x) {
+	int16_t n = 15;
+	
+	if (x == 0)
+		return 0;
+	
+	while (!(x & 0x8000)) { // Normalize so the leading one is bit 15
+		x <<= 1;
+		n--;
+	}
+	
+	uint16_t t = (x >> 7) & 0xFF; // Mantissa fraction in Q8
+	
+	// log2(1 + t) ~= t + 0.3466 * t * (1 - t)
+	return (n << 8) + t + (uint16_t) (((uint32_t) 89 * t * (256 - t)) >> 16);
+}
+
+uint16_t fx_exp2(int16_t y) {
+	if (y < 0)
+		return 0;
+	if (y >= (16 << 8))
+		return 0xFFFF;
+	
+	uint8_t n = y >> 8;
+	uint16_t f = y & 0xFF;
+	
+	// 2^f ~= 1 + f * (0.6565 + 0.3435 * f), in Q8
+	uint32_t m = 256 + ((f * (168 + ((88 * f) >> 8))) >> 8);
+	
+	return (m << n) >> 8;
+}
+
+uint16_t fx_sqrt(uint32_t x) {
+	uint32_t root = 0;
+	uint32_t bit = (uint32_t) 1 << 30;
+	
+	while (bit > x)
+		bit >>= 2;
+	
+	while (bit != 0) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	
+	return root;
+}
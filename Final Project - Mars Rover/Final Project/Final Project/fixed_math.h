@@ -0,0 +1,35 @@
+/*! \file fixed_math.h
+    \brief Fixed point helpers for math that has to run on the robot without soft-float.
+	
+	Values tagged Q8 carry 8 fractional bits (256 = 1.0).
+*/
+
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+
+#include <inttypes.h>
+
+/// Base 2 logarithm of an unsigned integer.
+/**
+* Uses the position of the leading one for the integer part and a quadratic fit for the fraction. Error is below 0.02.
+* @param x value to take the logarithm of. Must not be zero.
+* @return log2(x) in Q8
+*/
+int16_t fx_log2(uint16_t x);
+
+/// Base 2 exponential.
+/**
+* Inverse of fx_log2. Saturates at 0xFFFF.
+* @param y exponent in Q8. Negative exponents return zero.
+* @return 2^y rounded down to an integer
+*/
+uint16_t fx_exp2(int16_t y);
+
+/// Integer square root.
+/**
+* @param x value to take the square root of
+* @return floor(sqrt(x))
+*/
+uint16_t fx_sqrt(uint32_t x);
+
+#endif
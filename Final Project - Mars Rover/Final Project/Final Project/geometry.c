@@ -0,0 +1,97 @@
+/*
+ * geometry.c
+ *
+ * Integer trigonometry. See geometry.h.
+ */
+
+#include <stdlib.h>
+#include <avr/pgmspace.h>
+#include "fixed_math.h"
+#include "geometry.h"
+
+/* atan(k / 64) as a binary angle for k = 0 to 64 */
+static const uint16_t atan_table[65] PROGMEM = {
+	0, 163, 326, 489, 651, 813, 975, 1136, 1297, 1457, 1617, 1775, 1933,
+	2090, 2246, 2401, 2555, 2708, 2860, 3010, 3159, 3307, 3453, 3599, 3742, 3884,
+	4025, 4164, 4302, 4438, 4572, 4705, 4836, 4966, 5094, 5220, 5344, 5467, 5589,
+	5708, 5826, 5943, 6058, 6171, 6282, 6392, 6500, 6607, 6712, 6815, 6917, 7018,
+	7117, 7214, 7310, 7405, 7498, 7589, 7679, 7768, 7856, 7942, 8026, 8110, 8192
+};
+
+/* sin(k * 90 / 64 degrees) in Q14 for k = 0 to 64 */
+static const int16_t sin_table[65] PROGMEM = {
+	0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756,
+	5139, 5520, 5897, 6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434,
+	9760, 10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406, 12665, 12916, 13160,
+	13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978, 15137, 15286, 15426, 15557,
+	15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379, 16384
+};
+
+uint16_t geo_atan2(int16_t y, int16_t x) {
+	uint16_t ax = (x < 0) ? -(int32_t) x : x;
+	uint16_t ay = (y < 0) ? -(int32_t) y : y;
+	uint8_t steep = ay > ax; // Work in the first octant, where the ratio is at most 1
+	uint16_t angle;
+	
+	if (ax == 0 && ay == 0)
+		return 0;
+	
+	uint16_t ratio = steep ? ((uint32_t) ax << 12) / ay : ((uint32_t) ay << 12) / ax; // Q12, 0 to 4096
+	uint8_t index = ratio >> 6;
+	uint8_t fraction = ratio & 0x3F;
+	
+	angle = pgm_read_word(&atan_table[index]);
+	if (fraction)
+		angle += ((pgm_read_word(&atan_table[index + 1]) - angle) * fraction + 32) >> 6; // Rounded
+	
+	if (steep)
+		angle = 16384 - angle; // 90 degrees - angle
+	if (x < 0)
+		angle = 32768 - angle; // 180 degrees - angle
+	if (y < 0)
+		angle = -angle;
+	
+	return angle;
+}
+
+uint16_t geo_hypot(int16_t x, int16_t y) {
+	return fx_sqrt((int32_t) x * x + (int32_t) y * y);
+}
+
+/* Sine of the first quarter turn. angle is 0 to 16384. */
+static int16_t quarter_sin(uint16_t angle) {
+	uint8_t index = angle >> 8;
+	uint8_t fraction = angle & 0xFF;
+	int16_t value = pgm_read_word(&sin_table[index]);
+	
+	if (index == 64 || fraction == 0)
+		return value;
+	
+	return value + (((int32_t) ((int16_t) pgm_read_word(&sin_table[index + 1]) - value) * fraction) >> 8);
+}
+
+static int16_t binary_sin(uint16_t angle) {
+	uint16_t within = angle & 0x3FFF;
+	
+	if (angle < 16384)
+		return quarter_sin(within);
+	else if (angle < 32768)
+		return quarter_sin(16384 - within);
+	else if (angle < 49152)
+		return -quarter_sin(within);
+	else
+		return -quarter_sin(16384 - within);
+}
+
+void geo_sincos(uint16_t angle, int16_t* sine, int16_t* cosine) {
+	*sine = binary_sin(angle);
+	*cosine = binary_sin(angle + 16384);
+}
+
+void geo_project(float* x, float* y, int16_t distance, uint16_t angle) {
+	int16_t sine, cosine;
+	
+	geo_sincos(angle, &sine, &cosine);
+	*x += ((int32_t) distance * cosine) / (float) GEO_ONE;
+	*y += ((int32_t) distance * sine) / (float) GEO_ONE;
+}
@@ -0,0 +1,61 @@
+/*! \file geometry.h
+    \brief Integer trigonometry for object bearings, ranges and coordinate projection.
+	
+	Angles are binary angles: a uint16_t where 65536 is a full turn, so adding and subtracting
+	angles wraps around 360 degrees for free. Sine and cosine are returned in Q14 (16384 = 1.0).
+*/
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <inttypes.h>
+
+/*! \def GEO_ONE
+	\brief 1.0 in the Q14 format returned by geo_sincos()
+*/
+#define GEO_ONE 16384
+/*! \def GEO_DEGREES
+	\brief Converts degrees (any sign, may be a float) to a binary angle
+*/
+#define GEO_DEGREES(d) ((uint16_t) (int32_t) ((d) * 65536L / 360))
+/*! \def GEO_TO_DEGREES
+	\brief Converts a binary angle to whole degrees from 0 to 359
+*/
+#define GEO_TO_DEGREES(a) ((uint16_t) (((uint32_t) (uint16_t) (a) * 360 + 32768) >> 16) % 360)
+
+/// Angle of the vector (x, y) from the positive x axis.
+/**
+* Table based with linear interpolation. Accurate to 0.019 degrees (host/geocheck.c checks it). (0, 0) returns 0.
+* @param y y component
+* @param x x component
+* @return binary angle, counterclockwise
+*/
+uint16_t geo_atan2(int16_t y, int16_t x);
+
+/// Length of the vector (x, y).
+/**
+* @param x x component
+* @param y y component
+* @return sqrt(x^2 + y^2), rounded down
+*/
+uint16_t geo_hypot(int16_t x, int16_t y);
+
+/// Sine and cosine of a binary angle.
+/**
+* Quarter wave table with linear interpolation.
+* @param angle binary angle
+* @param sine set to the sine in Q14
+* @param cosine set to the cosine in Q14
+*/
+void geo_sincos(uint16_t angle, int16_t* sine, int16_t* cosine);
+
+/// Moves a point a distance along a bearing.
+/**
+* @param x x coordinate to move, in cm
+* @param y y coordinate to move, in cm
+* @param distance distance to move, in cm
+* @param angle binary angle to move along
+*/
+void geo_project(float* x, float* y, int16_t distance, uint16_t angle);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * avr/eeprom.h (host build)
+ *
+ * EEPROM reads as erased (0xFF) and writes are dropped, so every run starts from default calibration.
+ */
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM
+
+static inline void eeprom_read_block(void* dst, const void* src, size_t n) { (void) src; memset(dst, 0xFF, n); }
+static inline void eeprom_update_block(const void* src, void* dst, size_t n) { (void) src; (void) dst; (void) n; }
+static inline void eeprom_write_block(const void* src, void* dst, size_t n) { (void) src; (void) dst; (void) n; }
+static inline uint8_t eeprom_read_byte(const uint8_t* p) { (void) p; return 0xFF; }
+static inline uint16_t eeprom_read_word(const uint16_t* p) { (void) p; return 0xFFFF; }
+static inline void eeprom_update_byte(uint8_t* p, uint8_t v) { (void) p; (void) v; }
+static inline void eeprom_update_word(uint16_t* p, uint16_t v) { (void) p; (void) v; }
+static inline void eeprom_busy_wait(void) { }
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * avr/interrupt.h (host build)
+ *
+ * Handlers compile to ordinary functions. Only the simulator build calls one (USART1_RX_vect, from
+ * sim.c); otherwise they go unused.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector) void vector(void)
+#define sei()
+#define cli()
+
+#endif
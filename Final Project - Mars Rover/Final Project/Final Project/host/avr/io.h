@@ -0,0 +1,73 @@
+/*
+ * avr/io.h (host build)
+ *
+ * Stands in for the AVR register definitions so firmware sources compile on a PC. Every register is
+ * a plain variable that host_hw.c defines; nothing reads them back. In the simulator build (HOST_SIM)
+ * the USART1 status and data registers are wired to the simulated Create instead; see sim.c.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#ifdef HOST_DEFINE_REGISTERS
+#define HOST_R8(n) volatile uint8_t n;
+#define HOST_R16(n) volatile uint16_t n;
+#else
+#define HOST_R8(n) extern volatile uint8_t n;
+#define HOST_R16(n) extern volatile uint16_t n;
+#endif
+
+HOST_R8(UBRR0L) HOST_R8(UBRR0H) HOST_R8(UCSR0A) HOST_R8(UCSR0B) HOST_R8(UCSR0C) HOST_R8(UDR0)
+HOST_R8(UBRR1L) HOST_R8(UBRR1H) HOST_R8(UCSR1B) HOST_R8(UCSR1C)
+HOST_R8(DDRA) HOST_R8(PORTA) HOST_R8(DDRB) HOST_R8(PORTB) HOST_R8(PINB) HOST_R8(DDRD) HOST_R8(PORTD) HOST_R8(DDRE) HOST_R8(PORTE)
+HOST_R8(TIMSK) HOST_R8(ETIMSK) HOST_R8(TIFR) HOST_R8(TCCR1A) HOST_R8(TCCR1B) HOST_R8(TCCR2) HOST_R8(OCR2) HOST_R8(TCNT2) HOST_R8(TCCR3A) HOST_R8(TCCR3B)
+HOST_R16(TCNT1) HOST_R16(ICR1) HOST_R16(OCR1A) HOST_R16(TCNT3) HOST_R16(OCR3A) HOST_R16(OCR3B) HOST_R16(ADC)
+HOST_R8(ADMUX) HOST_R8(ADCSRA) HOST_R8(MCUCR) HOST_R8(MCUCSR) HOST_R8(SREG)
+HOST_R16(EEAR) HOST_R8(EEDR) HOST_R8(EECR)
+
+#ifdef HOST_SIM
+volatile uint8_t* host_uart1_status(void);
+volatile uint16_t* host_uart1_data(void);
+#define UCSR1A (*host_uart1_status())
+#define UDR1 (*host_uart1_data())
+#else
+HOST_R8(UCSR1A) HOST_R8(UDR1)
+#endif
+
+#define RXEN 4
+#define TXEN 3
+#define RXC 7
+#define UDRE 5
+#define FE 4
+#define DOR 3
+#define UPE 2
+#define U2X 1
+#define RXEN0 4
+#define TXEN0 3
+#define RXC0 7
+#define UDRE0 5
+#define U2X0 1
+#define RXCIE0 7
+#define RXCIE1 7
+#define UCSZ00 1
+#define UCSZ10 1
+#define USBS0 3
+#define TICIE1 5
+#define TOIE1 2
+#define TOV1 2
+#define OCIE1A 4
+#define OCF1A 4
+#define ICF1 5
+#define EERIE 3
+#define EEMWE 2
+#define EEWE 1
+
+#define RAMSTART 0x100
+#define RAMEND 0x10FF
+#define E2END 0xFFF
+
+#define _BV(b) (1 << (b))
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * avr/pgmspace.h (host build)
+ *
+ * Flash and RAM share one address space on the host.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define pgm_read_word(p) (*(const uint16_t*) (p))
+#define sprintf_P sprintf
+#define strcpy_P strcpy
+#define strchr_P strchr
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * avr/sleep.h (host build)
+ *
+ * Sleeping lets simulated time pass up to the next interrupt; see host_sleep() in host_hw.c.
+ */
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+
+void host_sleep(void);
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() host_sleep()
+
+#endif
@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# run.sh
+#
+# Runs the standard missions through the firmware on the simulator (see host/sim.h) and prints the
+# results as one JSON document, so two builds can be compared before a run day. Run from the
+# project directory:
+#   host/bench/run.sh [seeds] > results.json
+#
+# Each mission runs once for each seed from 1 to seeds (default 5); the seed draws the noise:
+#   scan    one 180 degree scan ('q') of three posts, one of each size class
+#   cliff   a 1 m drive ('{M100}') towards a hole 60 cm ahead
+#   red     exploring ('e') a pen until the red retrieval zone is found
+#   battery the same with the battery almost down to the dock reserve
+#   repeat  50 scans in a row
+#
+# Each result has:
+#   simulated_s          mission time as the robot would see it
+#   wall_s               time the host took to run it
+#   goal_s               when a cliff sensor first went over red tape, or null
+#   create_bytes_out/in  bytes over the Create link
+#   bluetooth_bytes_out/in  bytes over the bluetooth link
+#   cpu_busy_pct         share of the mission the firmware wasn't idle
+#   samples_per_s        IR and SONAR samples per simulated second, the scan throughput
+#   posts_found, position_error_cm  posts in the final object table and how far off they were on average
+#   driven_cm, bumps, cliffs, fell  what the Create did
+
+seeds=${1:-5}
+bench=host/bench
+build=$(mktemp -d) || exit 1
+trap 'rm -rf "$build"' EXIT
+
+gcc -std=gnu99 -O2 -funsigned-char -funsigned-bitfields -DNPROFILE -DHOST_SIM -Dmain=firmware_main -Ihost \
+	-o "$build/simulate" host/simulate.c host/sim.c host/host_hw.c open_interface.c main.c object_tracking.c \
+	scan.c sensor_fusion.c geometry.c fixed_math.c calibration.c profile.c compress.c surface.c \
+	script.c sequence.c lookahead.c pose.c explore.c idle.c energy.c -lm || exit 1
+
+repeat=$(printf 'q%.0s' $(seq 50))
+
+run() { # name arena commands time-limit
+	for seed in $(seq "$seeds"); do
+		[ -n "$first" ] && echo ","
+		first=no
+		printf '    '
+		"$build/simulate" -j "$1" -s "$seed" -t "$4" "$bench/$2" "$3" | tr -d '\n'
+	done
+}
+
+echo "{"
+echo "  \"commit\": \"$(git rev-parse --short HEAD 2>/dev/null)\","
+echo "  \"results\": ["
+run scan scan.arena q 60
+run cliff cliff.arena '{M100}' 60
+run red red.arena e 600
+run battery battery.arena e 600
+run repeat scan.arena "$repeat" 600
+echo
+echo "  ]"
+echo "}"
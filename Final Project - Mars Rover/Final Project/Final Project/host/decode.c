@@ -0,0 +1,138 @@
+/*
+ * decode.c
+ *
+ * Pulls bulk scan frames out of a saved bluetooth log and prints each sample as
+ * "<degrees> <IR mm> <SONAR ticks>". Frames with a bad checksum are reported and skipped.
+ *
+ * Build and run from the project directory:
+ *   gcc -std=gnu99 -O2 -I. -o decode host/decode.c
+ *   ./decode bluetooth.log
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scan.h"
+#include "compress.h"
+
+/* Decodes one comp_series of n readings. Returns the bytes used, or 0 if the data runs out. */
+static size_t decode_series(const uint8_t* in, size_t size, uint16_t* out, int n) {
+	size_t used = 0;
+	uint16_t value = 0;
+	int count = 0;
+	
+	while (count < n && used < size) {
+		uint8_t b = in[used++];
+		uint16_t zigzag;
+		
+		if (b >= COMP_RUN && b < COMP_WIDE) { // Run of unchanged readings
+			for (int i = 0; i < b - COMP_RUN + 1 && count < n; i++)
+				out[count++] = value;
+			continue;
+		} else if (b < COMP_RUN) {
+			zigzag = b;
+		} else if (b < COMP_FULL) {
+			if (used + 1 > size)
+				return 0;
+			zigzag = ((b & 0x3F) << 8) | in[used++];
+		} else {
+			if (used + 2 > size)
+				return 0;
+			zigzag = in[used] | (in[used + 1] << 8);
+			used += 2;
+		}
+		
+		value += (zigzag >> 1) ^ -(zigzag & 1);
+		out[count++] = value;
+	}
+	
+	return (count == n) ? used : 0;
+}
+
+/* Decodes a frame payload into ir and sonar. Returns 0 if it is malformed. */
+static int decode_payload(uint8_t flags, const uint8_t* p, size_t length, int n, uint16_t* ir, uint16_t* sonar) {
+	if (flags & SCAN_FRAME_PACKED) {
+		size_t used = decode_series(p, length, ir, n);
+		return used && decode_series(p + used, length - used, sonar, n) == length - used;
+	}
+	
+	size_t j = 0;
+	for (int i = 0; i < n; i++) {
+		if (i == 0 || !(flags & SCAN_FRAME_DELTA)) {
+			if (j + 4 > length)
+				return 0;
+			ir[i] = p[j] | (p[j + 1] << 8);
+			sonar[i] = p[j + 2] | (p[j + 3] << 8);
+			j += 4;
+			continue;
+		}
+		
+		uint16_t* field[2] = {ir, sonar};
+		for (int f = 0; f < 2; f++) {
+			if (j >= length)
+				return 0;
+			if (p[j] == SCAN_DELTA_ESCAPE) {
+				if (j + 3 > length)
+					return 0;
+				field[f][i] = p[j + 1] | (p[j + 2] << 8);
+				j += 3;
+			} else {
+				field[f][i] = field[f][i - 1] + (int8_t) p[j];
+				j++;
+			}
+		}
+	}
+	
+	return j == length;
+}
+
+int main(int argc, char** argv) {
+	FILE* in = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+	
+	if (!in) {
+		perror(argv[1]);
+		return 1;
+	}
+	
+	size_t size = 0, capacity = 1 << 16;
+	uint8_t* data = malloc(capacity);
+	size_t got;
+	while ((got = fread(data + size, 1, capacity - size, in)) > 0) {
+		size += got;
+		if (size == capacity)
+			data = realloc(data, capacity *= 2);
+	}
+	
+	int frames = 0;
+	for (size_t i = 0; i + 7 <= size; i++) {
+		if (data[i] != SCAN_FRAME_SYNC1 || data[i + 1] != SCAN_FRAME_SYNC2)
+			continue;
+		
+		uint8_t flags = data[i + 2];
+		int n = data[i + 3];
+		size_t length = data[i + 4] | (data[i + 5] << 8);
+		if (i + 7 + length > size)
+			continue;
+		
+		uint8_t sum = 0;
+		for (size_t j = i + 2; j < i + 7 + length; j++)
+			sum += data[j];
+		if (sum != 0) {
+			fprintf(stderr, "decode: bad checksum at byte %zu\n", i);
+			continue;
+		}
+		
+		uint16_t ir[256], sonar[256];
+		if (!decode_payload(flags, data + i + 6, length, n, ir, sonar)) {
+			fprintf(stderr, "decode: malformed frame at byte %zu\n", i);
+			continue;
+		}
+		
+		printf("# frame %d: %d samples, %zu bytes (%.1fx smaller than raw)\n", frames++, n, length + 7, (n * 4.0 + 7) / (length + 7));
+		for (int j = 0; j < n; j++)
+			printf("%d %u %u\n", j, ir[j], sonar[j]);
+		i += 6 + length;
+	}
+	
+	return 0;
+}
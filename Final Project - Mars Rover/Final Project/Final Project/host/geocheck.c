@@ -0,0 +1,113 @@
+/*
+ * geocheck.c
+ *
+ * Sweeps geo_atan2(), geo_sincos() and geo_hypot() against the C library and prints the
+ * largest error of each next to the accuracy geometry.h promises. Exits with 1 if any is out.
+ *
+ * Build and run from the project directory:
+ *   gcc -std=gnu99 -O2 -funsigned-char -I. -Ihost -o geocheck host/geocheck.c geometry.c fixed_math.c -lm
+ *   ./geocheck
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "geometry.h"
+
+#define ATAN2_LIMIT 0.019   // Degrees
+#define SINCOS_LIMIT 3      // Q14 steps
+#define HYPOT_LIMIT 0       // geo_hypot() rounds down exactly
+
+/* Components the sweeps use: every value near 0, a stride through the rest, and the extremes */
+static int component(int i) {
+	static const int edges[] = {-32768, -32767, -32766, 32765, 32766, 32767};
+
+	if (i < 6)
+		return edges[i];
+	i -= 6;
+	if (i < 129)
+		return i - 64;
+	i -= 129;
+	return -32768 + 61 + i * 127; // Runs to 32708
+}
+
+#define COMPONENTS (6 + 129 + 516)
+
+static double worst_atan2;
+static int worst_atan2_x, worst_atan2_y;
+
+static void check_atan2(int y, int x) {
+	if (x == 0 && y == 0)
+		return;
+
+	double want = atan2(y, x) * 180 / M_PI;
+	double got = geo_atan2(y, x) * 360.0 / 65536;
+	double error = fabs(remainder(got - want, 360));
+
+	if (error > worst_atan2) {
+		worst_atan2 = error;
+		worst_atan2_x = x;
+		worst_atan2_y = y;
+	}
+}
+
+int main(void) {
+	int failed = 0;
+
+	/* atan2: the sweep grid, plus every direction on a circle of radius 10000 */
+	for (int i = 0; i < COMPONENTS; i++)
+		for (int j = 0; j < COMPONENTS; j++)
+			check_atan2(component(i), component(j));
+	for (int a = 0; a < 360 * 64; a++) {
+		double r = a * M_PI / (180 * 64);
+		check_atan2(lround(10000 * sin(r)), lround(10000 * cos(r)));
+	}
+	printf("geo_atan2:  worst %.4f degrees at (%d, %d), limit %.3f\n", worst_atan2, worst_atan2_x, worst_atan2_y, ATAN2_LIMIT);
+	failed |= worst_atan2 > ATAN2_LIMIT;
+
+	/* sin and cos: every binary angle */
+	int worst_sincos = 0;
+	unsigned worst_angle = 0;
+	for (unsigned a = 0; a < 65536; a++) {
+		int16_t s, c;
+		double r = a * 2 * M_PI / 65536;
+
+		geo_sincos(a, &s, &c);
+		int error = fmax(fabs(s - GEO_ONE * sin(r)), fabs(c - GEO_ONE * cos(r))) + 0.5;
+		if (error > worst_sincos) {
+			worst_sincos = error;
+			worst_angle = a;
+		}
+	}
+	printf("geo_sincos: worst %d/16384 at angle %u, limit %d/16384\n", worst_sincos, worst_angle, SINCOS_LIMIT);
+	failed |= worst_sincos > SINCOS_LIMIT;
+
+	/* hypot: the sweep grid, against the exact floor of the square root */
+	long worst_hypot = 0;
+	int worst_hypot_x = 0, worst_hypot_y = 0;
+	for (int i = 0; i < COMPONENTS; i++) {
+		for (int j = 0; j < COMPONENTS; j++) {
+			int x = component(i), y = component(j);
+			long long sum = (long long) x * x + (long long) y * y;
+			long long want = sqrtl(sum);
+			while (want * want > sum)
+				want--;
+			while ((want + 1) * (want + 1) <= sum)
+				want++;
+			if (want > 65535) // Doesn't fit the result
+				continue;
+
+			long error = labs((long) geo_hypot(x, y) - (long) want);
+			if (error > worst_hypot) {
+				worst_hypot = error;
+				worst_hypot_x = x;
+				worst_hypot_y = y;
+			}
+		}
+	}
+	printf("geo_hypot:  worst %ld at (%d, %d), limit %d\n", worst_hypot, worst_hypot_x, worst_hypot_y, HYPOT_LIMIT);
+	failed |= worst_hypot > HYPOT_LIMIT;
+
+	printf(failed ? "FAILED\n" : "ok\n");
+	return failed;
+}
@@ -0,0 +1,58 @@
+/*! \file host.h
+    \brief Host build of the firmware.
+	
+	host_hw.c replaces the hardware modules (util.c, open_interface.c, lcd.c, sram.c, recorder.c)
+	with versions that run on a PC. Everything the robot would sense comes from a data source that
+	implements the functions below, so the tracking code itself compiles unmodified.
+
+	There are two data sources: replay.c plays back a captured run, and sim.c simulates an arena and
+	a Create. The simulator build (HOST_SIM) keeps the real open_interface.c, which talks to the
+	simulated Create over a simulated USART1, so host_next_frame() is only used by replay.c.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <inttypes.h>
+#include "../open_interface.h"
+
+/// Next command the operator sends, or -1 when there are no more.
+int host_next_command(void);
+
+/// Fills the next Create sensor frame. Returns 0 if the source has none.
+int host_next_frame(oi_t* self);
+
+/// Gets the next sensor sample, taken with the servo at degrees. Returns 0 if the source has none.
+int host_next_sample(float degrees, unsigned int* ir_adc, unsigned int* sonar_ticks);
+
+/// Called once the last command has been handled. Does not return.
+void host_finish(void);
+
+/// Everything the firmware sends over bluetooth.
+void host_bluetooth(const char* data, int length);
+
+/// Lets the source catch up to host_ticks. Called whenever the firmware waits or reads the clock.
+void host_run(void);
+
+/// When the source could next raise an interrupt, in host_ticks. A sleeping firmware wakes then at the latest.
+unsigned long host_next_event(void);
+
+/// Wheel speeds last sent with oi_set_wheels(), in mm/s.
+extern int16_t host_right_wheel, host_left_wheel;
+
+/// Servo angle last set with move_servo(), in degrees.
+extern float host_servo_degrees;
+
+/// Simulated time, advanced by wait_ms() and sleeping. In timer 1 ticks (4 us each).
+extern unsigned long host_ticks;
+
+/// Time each uptime_ticks() call takes, so loops that wait on the clock get somewhere. 0 unless the source sets it.
+extern unsigned long host_poll_ticks;
+
+/// Simulated time the firmware has spent idle, waiting for an interrupt. In timer 1 ticks.
+extern unsigned long host_idle_ticks;
+
+/// Above 0 while an atomic block or an interrupt handler holds off interrupts.
+extern volatile int host_irq_off;
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * host_hw.c
+ *
+ * Host versions of the hardware modules. See host.h.
+ */
+
+#define HOST_DEFINE_REGISTERS
+#include <avr/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "../util.h"
+#include "../fixed_math.h"
+#include "../calibration.h"
+#include "../lcd.h"
+#include "../sram.h"
+#include "../recorder.h"
+#include "../idle.h"
+#include "host.h"
+
+int16_t host_right_wheel, host_left_wheel;
+float host_servo_degrees;
+unsigned long host_ticks;
+unsigned long host_poll_ticks;
+unsigned long host_idle_ticks;
+volatile int host_irq_off;
+
+static unsigned int sample_ir_adc;
+static unsigned int sample_sonar_ticks;
+
+void TIMER1_COMPA_vect(void); // idle.c's alarm interrupt
+
+/* Time passes up to the source's next event or idle_alarm(), whichever is first */
+void host_sleep(void) {
+	unsigned long wake = host_next_event();
+	char alarm = 0;
+	
+	if (TIMSK & (1 << OCIE1A)) {
+		unsigned long at = host_ticks + (uint16_t) (OCR1A - (uint16_t) host_ticks);
+		if ((long) (at - wake) <= 0) {
+			wake = at;
+			alarm = 1;
+		}
+	}
+	if ((long) (wake - host_ticks) > 0) {
+		host_idle_ticks += wake - host_ticks;
+		host_ticks = wake;
+	}
+	if (alarm)
+		TIMER1_COMPA_vect();
+	host_run();
+}
+
+/************************************************************************/
+/* util.c                                                               */
+/************************************************************************/
+
+/* Sleeps on the alarm, 262 ms at a time, so the time counts as idle */
+void wait_ms(unsigned int time_val) {
+	unsigned long end = host_ticks + time_val * 250UL;
+	
+	while ((long) (host_ticks - end) < 0) {
+		idle_alarm((end - host_ticks > 0xFFFF) ? host_ticks + 0xFFFF : end);
+		idle_sleep();
+	}
+}
+
+void timer2_start(char unit) {
+}
+
+void timer2_stop() {
+}
+
+void ADC_init() {
+}
+
+unsigned int read_ADC() {
+	return sample_ir_adc;
+}
+
+unsigned int read_IR_raw() {
+	return sample_ir_adc;
+}
+
+/* Same curve as util.c */
+unsigned int read_IR_distance_mm() {
+	unsigned int quantVal = read_IR_raw();
+	uint16_t distance = 27520;
+	
+	if (quantVal != 0)
+		distance = fx_exp2(850 + cal_store.ir_log2_coeff - (((int32_t) cal_store.ir_exponent * fx_log2(quantVal)) >> 8));
+	
+	return (distance > 27520) ? 27520 : distance;
+}
+
+int read_IR_distance() {
+	return read_IR_distance_mm() / 10;
+}
+
+void ping_timer_init() {
+}
+
+/* Each pulse takes the next sample, so IR and SONAR readings that follow belong to the same position */
+void send_pulse() {
+	if (!host_next_sample(host_servo_degrees, &sample_ir_adc, &sample_sonar_ticks)) {
+		sample_ir_adc = 0;      // Nothing in range
+		sample_sonar_ticks = 0;
+	}
+}
+
+unsigned int read_PING_ticks() {
+	return sample_sonar_ticks;
+}
+
+float read_PING_distance() {
+	return ((sample_sonar_ticks/(16000000.0/64.0))*(34300.0/2.0));
+}
+
+unsigned long uptime_ticks() {
+	host_ticks += host_poll_ticks;
+	host_run();
+	return host_ticks;
+}
+
+void servo_timer_init() {
+}
+
+void move_servo(volatile float* degrees) {
+	if (*degrees > 180)
+		*degrees = 180;
+	else if (*degrees < 0)
+		*degrees = 0;
+	host_servo_degrees = *degrees;
+}
+
+void servo_set_pulse(unsigned int pulse) {
+}
+
+void USART_Init(unsigned int ubrr) {
+}
+
+void USART_Transmit(unsigned char data) {
+	host_bluetooth((char*) &data, 1);
+}
+
+unsigned char USART_Receive(void) {
+	int c = host_next_command();
+	
+	if (c < 0)
+		host_finish();
+	return c;
+}
+
+unsigned char USART_Available(void) {
+	return 0;
+}
+
+unsigned char USART_Wait(unsigned int ms) {
+	return 1; // The next command is always ready
+}
+
+void send_message(char *message) {
+	host_bluetooth(message, strlen(message));
+}
+
+void send_message_P(const char *message) {
+	host_bluetooth(message, strlen(message));
+}
+
+/************************************************************************/
+/* open_interface.c (the simulator build uses the real one)             */
+/************************************************************************/
+
+#ifndef HOST_SIM
+
+oi_t* oi_alloc() {
+	return calloc(1, sizeof(oi_t));
+}
+
+void oi_free(oi_t *self) {
+	free(self);
+}
+
+void oi_init(oi_t *self) {
+}
+
+/* When the source runs out of frames, the Create is assumed to move exactly as commanded so drive loops still end */
+void oi_update(oi_t *self) {
+	host_ticks += 50 * 250UL; // Sensor query and the 35 ms settle
+	
+	if (host_next_frame(self))
+		return;
+	
+	self->distance = (host_right_wheel + host_left_wheel) / 2 / 20; // 50 ms at the commanded speed
+	self->angle = (host_right_wheel - host_left_wheel) * 0.05 * 57.3 / 258; // 258 mm wheel base
+}
+
+void oi_set_leds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uint8_t power_intensity) {
+}
+
+void oi_set_wheels(int16_t right_wheel, int16_t left_wheel) {
+	host_right_wheel = right_wheel;
+	host_left_wheel = left_wheel;
+}
+
+void oi_byte_tx(unsigned char value) {
+}
+
+unsigned char oi_byte_rx(void) {
+	return 0;
+}
+
+void oi_load_song(int song_index, int num_notes, unsigned char  *notes, unsigned char  *duration) {
+}
+
+void oi_play_song(int index) {
+}
+
+void go_charge(void) {
+}
+
+void oi_link_report(void) {
+	send_message("\r\nCreate link: replayed\r\n");
+}
+
+void oi_tx_begin(void) {
+}
+
+void oi_tx_end(void) {
+}
+
+unsigned long oi_frame_time(void) {
+	return host_ticks;
+}
+
+uint8_t oi_hazard_take(void) {
+	return 0; // Recorded frames already carry the bumps and cliffs the motion loops react to
+}
+
+#endif
+
+/************************************************************************/
+/* lcd.c, sram.c, recorder.c                                            */
+/************************************************************************/
+
+void lcd_init(void) {
+}
+
+void lprintf(const char *formatter, ...) {
+}
+
+void sram_report(void) {
+	send_message("\r\nSRAM usage is not measured in the host build\r\n");
+}
+
+void rec_init(void) {
+}
+
+void rec_log(uint8_t type, uint8_t arg, int16_t a, int16_t b) {
+}
+
+void rec_oi(oi_t* self) {
+}
+
+void rec_flush(void) {
+}
+
+void rec_idle(void) {
+}
+
+void rec_download(void) {
+	send_message("\r\nFlight recorder: 0 events, 0 dropped\r\n");
+}
@@ -0,0 +1,221 @@
+/*
+ * replay.c
+ *
+ * Replays a captured run through the unmodified firmware on a PC. Everything the robot would send
+ * over bluetooth goes to stdout, so two builds can be compared by diffing their output. Time spent
+ * handling each command goes to stderr.
+ *
+ * Build and run from the project directory:
+ *   gcc -std=gnu99 -O2 -funsigned-char -funsigned-bitfields -DNPROFILE -Dmain=firmware_main -Ihost
+ *       -o replay host/replay.c host/host_hw.c main.c object_tracking.c scan.c sensor_fusion.c
+ *       geometry.c fixed_math.c calibration.c profile.c compress.c surface.c script.c sequence.c
+ *       lookahead.c pose.c explore.c idle.c energy.c -lm
+ *   ./replay capture.txt > output.txt
+ *
+ * Capture lines, each kind consumed in order as the firmware asks for it:
+ *   C <command>                                      operator command
+ *   O <distance> <angle> <bumper left> <bumper right> <cliff left> <cliff front left>
+ *     <cliff front right> <cliff right> <cliff left signal> <cliff front left signal>
+ *     <cliff front right signal> <cliff right signal>  Create sensor frame
+ *   S <servo degrees> <IR ADC value> <SONAR echo ticks> sensor sample
+ *   R,<time>,<type>,<arg>,<a>,<b>                    flight recorder event (commands and sensor frames)
+ * Lines starting with # are ignored. After the last command a 'p' is sent so the final object table is printed.
+ */
+
+#undef main // Only the firmware's main is renamed
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../recorder.h"
+#include "host.h"
+
+#define MAX_LINES 100000
+
+typedef struct {
+	char kind;       // 'C', 'O', or 'S'
+	int value[12];
+} capture_line;
+
+static capture_line* lines;
+static int line_count;
+static int next_line[3]; // Next unread line of each kind
+
+static int command_calls[256];
+static double command_time[256];
+static double command_max[256];
+static int last_command = -1;
+static struct timespec last_start;
+static int final_report_sent;
+
+static int kind_index(char kind) {
+	return (kind == 'C') ? 0 : (kind == 'O') ? 1 : 2;
+}
+
+/* Next line of a kind, or 0 */
+static capture_line* next_of(char kind) {
+	int* i = &next_line[kind_index(kind)];
+	
+	while (*i < line_count && lines[*i].kind != kind)
+		(*i)++;
+	
+	return (*i < line_count) ? &lines[(*i)++] : 0;
+}
+
+static double elapsed_us(struct timespec* start, struct timespec* end) {
+	return (end->tv_sec - start->tv_sec) * 1e6 + (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+int host_next_command(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	if (last_command >= 0) { // Previous command is done
+		double us = elapsed_us(&last_start, &now);
+		command_calls[last_command]++;
+		command_time[last_command] += us;
+		if (us > command_max[last_command])
+			command_max[last_command] = us;
+	}
+	
+	capture_line* line = next_of('C');
+	if (line) {
+		last_command = (unsigned char) line->value[0];
+	} else if (!final_report_sent) {
+		final_report_sent = 1;
+		last_command = 'p';
+	} else {
+		last_command = -1;
+		return -1;
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, &last_start);
+	return last_command;
+}
+
+int host_next_frame(oi_t* self) {
+	capture_line* line = next_of('O');
+	
+	if (!line)
+		return 0;
+	
+	self->distance = line->value[0];
+	self->angle = line->value[1];
+	self->bumper_left = line->value[2];
+	self->bumper_right = line->value[3];
+	self->cliff_left = line->value[4];
+	self->cliff_frontleft = line->value[5];
+	self->cliff_frontright = line->value[6];
+	self->cliff_right = line->value[7];
+	self->cliff_left_signal = line->value[8];
+	self->cliff_frontleft_signal = line->value[9];
+	self->cliff_frontright_signal = line->value[10];
+	self->cliff_right_signal = line->value[11];
+	return 1;
+}
+
+int host_next_sample(float degrees, unsigned int* ir_adc, unsigned int* sonar_ticks) {
+	capture_line* line = next_of('S');
+	
+	if (!line)
+		return 0;
+	
+	if (line->value[0] != (int) degrees)
+		fprintf(stderr, "replay: sample for %d degrees read at %d degrees\n", line->value[0], (int) degrees);
+	*ir_adc = line->value[1];
+	*sonar_ticks = line->value[2];
+	return 1;
+}
+
+void host_bluetooth(const char* data, int length) {
+	fwrite(data, 1, length, stdout);
+}
+
+void host_run(void) {
+	// Nothing happens between the recorded frames
+}
+
+unsigned long host_next_event(void) {
+	return host_ticks + 0x10000UL; // Only the firmware's own alarm wakes it
+}
+
+void host_finish(void) {
+	fflush(stdout);
+	fprintf(stderr, "command  calls  total (us)  mean (us)  max (us)\n");
+	for (int i = 0; i < 256; i++)
+		if (command_calls[i] > 0)
+			fprintf(stderr, "%c        %5d  %10.0f  %9.0f  %8.0f\n", i, command_calls[i], command_time[i], command_time[i] / command_calls[i], command_max[i]);
+	exit(0);
+}
+
+/* Flight recorder lines only carry commands and the decimated sensor frames */
+static int parse_recorder(const char* text, capture_line* line) {
+	unsigned time, type, arg;
+	int a, b;
+	
+	if (sscanf(text, "R,%u,%u,%u,%d,%d", &time, &type, &arg, &a, &b) != 5)
+		return 0;
+	
+	memset(line, 0, sizeof(*line));
+	if (type == REC_COMMAND) {
+		line->kind = 'C';
+		line->value[0] = arg;
+	} else if (type == REC_OI) {
+		line->kind = 'O';
+		line->value[0] = a;
+		line->value[1] = b;
+		line->value[2] = (arg >> 1) & 1;
+		line->value[3] = arg & 1;
+		for (int i = 0; i < 4; i++)
+			line->value[4 + i] = (arg >> (2 + i)) & 1;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+static void load(FILE* in) {
+	char text[256];
+	int number = 0;
+	
+	lines = calloc(MAX_LINES, sizeof(capture_line));
+	while (fgets(text, sizeof(text), in) && line_count < MAX_LINES) {
+		capture_line* line = &lines[line_count];
+		int* v = line->value;
+		char command;
+		
+		number++;
+		memset(line, 0, sizeof(*line));
+		if (text[0] == '#' || text[0] == '\n' || text[0] == '\r') {
+			continue;
+		} else if (text[0] == 'R') {
+			if (!parse_recorder(text, line))
+				continue;
+		} else if (sscanf(text, "C %c", &command) == 1) {
+			line->kind = 'C';
+			v[0] = (unsigned char) command;
+		} else if (sscanf(text, "O %d %d %d %d %d %d %d %d %d %d %d %d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9], &v[10], &v[11]) == 12) {
+			line->kind = 'O';
+		} else if (sscanf(text, "S %d %d %d", &v[0], &v[1], &v[2]) == 3) {
+			line->kind = 'S';
+		} else {
+			fprintf(stderr, "replay: line %d not understood: %s", number, text);
+			continue;
+		}
+		line_count++;
+	}
+}
+
+int firmware_main(void);
+
+int main(int argc, char** argv) {
+	FILE* in = (argc > 1) ? fopen(argv[1], "r") : stdin;
+	
+	if (!in) {
+		perror(argv[1]);
+		return 1;
+	}
+	
+	load(in);
+	return firmware_main();
+}
@@ -0,0 +1,990 @@
+/*
+ * sim.c
+ *
+ * Simulated arena and Create. See sim.h.
+ */
+
+#include <avr/io.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../open_interface.h"
+#include "../object_tracking.h"
+#include "host.h"
+#include "sim.h"
+
+#define SIM_QUEUE 2048        // Bytes on their way from the Create
+#define SIM_COMMAND_MAX 512   // Longest command: a song, stream, or script with all its bytes
+#define SIM_SCRIPT_MAX 100    // Longest script the Create keeps
+#define SIM_SONGS 16
+#define SIM_STREAM_IDS 32
+#define SIM_UDR_TAG 0x8000    // On everything host_uart1_data() leaves in the data register, so a write can be told from a read
+#define SIM_IR_K 31427.0      // Sharp sensor curve, cm = K * ADC^-P. The one calibration.c's defaults were fitted to.
+#define SIM_IR_P 1.171
+#define SIM_IDLE_CURRENT 180  // mA with the wheels stopped
+#define SIM_DRIVE_CURRENT 0.6 // mA per mm/s of each wheel's speed
+
+void USART1_RX_vect(void); // open_interface.c's receive interrupt
+
+sim_arena sim;
+sim_stats sim_totals;
+
+/* Cliff sensors, cm ahead of and to the left of the middle of the Create, left to right */
+static const float cliff_sensors[4][2] = {{6.0, 14.0}, {15.0, 4.5}, {15.0, -4.5}, {6.0, -14.0}};
+
+/* Sizes of the sensor packets by id. 0 to 6 are groups of the ones after them. */
+static const uint8_t packet_size[43] = {
+	26, 10, 6, 10, 14, 12, 52,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 2, 2,
+	1, 2, 2, 1, 2, 2,
+	2, 2, 2, 2, 2, 1, 2, 1,
+	1, 1, 1, 1, 2, 2, 2, 2
+};
+static const uint8_t group_first[7] = {7, 7, 17, 21, 27, 35, 7};
+static const uint8_t group_last[7] = {26, 16, 20, 26, 34, 42, 42};
+
+/* Baud rates by OI_OPCODE_BAUD code */
+static const uint32_t baud_codes[12] = {300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 115200};
+
+static struct {
+	uint8_t mode;
+	uint32_t baud;
+	float x, y, heading;               // cm, cm, degrees
+	float right, left;                 // Wheel speeds now, mm/s
+	int16_t target_right, target_left; // Wheel speeds asked for
+	int16_t velocity, radius;          // Last Drive command
+	float distance_scale, angle_scale; // This Create's own odometry error
+	float distance, angle;             // Odometry not yet reported, mm and degrees
+	uint8_t bumps;                     // As in packet 7
+	uint8_t cliffs;                    // Bit per cliff sensor, left first
+	float charge;                      // mAh
+	int16_t current;                   // mA
+	float servo;                       // Where the servo points, degrees
+	unsigned long song_length[SIM_SONGS];
+	uint8_t song_number;
+	unsigned long song_end;
+	uint8_t stream[SIM_STREAM_IDS];
+	uint8_t stream_count;
+	char streaming;
+	unsigned long next_frame;
+	uint8_t script[SIM_SCRIPT_MAX];
+	uint8_t script_length;
+	uint8_t script_pc;
+	char script_running;
+	uint8_t wait;                      // Wait opcode holding up commands, or 0
+	long wait_target;
+	float wait_progress;
+	unsigned long wait_until;
+	uint8_t command[SIM_COMMAND_MAX];  // Command being received
+	int command_length;
+	uint8_t group6[OI_SENSOR_PACKET_GROUP6_SIZE]; // Sensors as of the packets being sent
+	char sent_distance, sent_angle;    // Have those packets gone out with it?
+} create;
+
+static struct {
+	uint8_t data;
+	unsigned long due;
+} queue[SIM_QUEUE];
+static int queue_head, queue_count;
+static unsigned long line_free;        // When the Create's transmitter is done with what it has
+
+static struct {
+	uint8_t data;
+	uint8_t flags;
+} rx[3];                               // USART1's receive buffer and shift register
+static uint8_t rx_count;
+static volatile uint8_t status_register;
+static volatile uint16_t data_register;
+static char data_touched;              // Has the firmware used the data register since it was last looked at?
+
+static unsigned long next_step;
+static uint64_t random_state;
+
+/************************************************************************/
+/* Noise                                                                */
+/************************************************************************/
+
+static double uniform(void) {
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return ((random_state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gauss(void) {
+	return sqrt(-2 * log(uniform() + 1e-300)) * cos(2 * M_PI * uniform());
+}
+
+/************************************************************************/
+/* Arena                                                                */
+/************************************************************************/
+
+static uint8_t floor_at(float x, float y) {
+	for (int i = sim.region_count - 1; i >= 0; i--) { // Later ones are on top
+		float* r = sim.regions[i];
+		if (x >= r[0] && x <= r[2] && y >= r[1] && y <= r[3])
+			return sim.region_surface[i];
+	}
+	return SIM_FLOOR;
+}
+
+/* How far the Create would overlap the nearest wall or post if it were at x, y, in cm. Sets the direction of that contact in degrees. */
+static float overlap(float x, float y, float* contact) {
+	float worst = -1e9;
+
+	for (int i = 0; i < sim.wall_count; i++) {
+		float* w = sim.walls[i];
+		float ex = w[2] - w[0], ey = w[3] - w[1];
+		float u = ((x - w[0]) * ex + (y - w[1]) * ey) / (ex * ex + ey * ey);
+		u = (u < 0) ? 0 : (u > 1) ? 1 : u;
+		float px = w[0] + u * ex, py = w[1] + u * ey; // Nearest point of the wall
+		float o = SIM_RADIUS - hypotf(px - x, py - y);
+		if (o > worst) {
+			worst = o;
+			*contact = atan2f(py - y, px - x) * 180 / M_PI;
+		}
+	}
+	for (int i = 0; i < sim.post_count; i++) {
+		float* p = sim.posts[i];
+		float o = SIM_RADIUS + p[2] / 2 - hypotf(p[0] - x, p[1] - y);
+		if (o > worst) {
+			worst = o;
+			*contact = atan2f(p[1] - y, p[0] - x) * 180 / M_PI;
+		}
+	}
+	return worst;
+}
+
+/* Distance along a ray to the nearest wall or post, or range if nothing is closer. The SONAR doesn't hear walls it meets at a shallow angle. */
+static float cast(float ox, float oy, float bearing, float range, char sonar) {
+	float dx = cosf(bearing * M_PI / 180), dy = sinf(bearing * M_PI / 180);
+	float best = range;
+
+	for (int i = 0; i < sim.wall_count; i++) {
+		float* w = sim.walls[i];
+		float ex = w[2] - w[0], ey = w[3] - w[1];
+		float denominator = dx * ey - dy * ex;
+		if (fabsf(denominator) < 1e-6)
+			continue; // Parallel
+		float t = ((w[0] - ox) * ey - (w[1] - oy) * ex) / denominator;
+		float u = ((w[0] - ox) * dy - (w[1] - oy) * dx) / denominator;
+		if (t < 0 || t >= best || u < 0 || u > 1)
+			continue;
+		if (sonar && fabsf(denominator) / hypotf(ex, ey) < cosf(SIM_SONAR_INCIDENCE * M_PI / 180))
+			continue; // Echo goes off somewhere else
+		best = t;
+	}
+	for (int i = 0; i < sim.post_count; i++) { // A round post always echoes straight back
+		float* p = sim.posts[i];
+		float fx = ox - p[0], fy = oy - p[1];
+		float b = fx * dx + fy * dy;
+		float c = fx * fx + fy * fy - p[2] * p[2] / 4;
+		float discriminant = b * b - c;
+		if (discriminant < 0)
+			continue;
+		float t = -b - sqrtf(discriminant);
+		if (t >= 0 && t < best)
+			best = t;
+	}
+	return best;
+}
+
+static void defaults(void) {
+	static const uint16_t signal[SIM_SURFACES][4] = { // Inside surface.c's bands
+		{250, 250, 250, 250},  // SIM_FLOOR
+		{505, 795, 405, 520},  // SIM_WHITE
+		{900, 1200, 750, 880}, // SIM_RED
+		{5, 5, 5, 5}           // SIM_CLIFF
+	};
+
+	memset(&sim, 0, sizeof(sim));
+	sim.start_heading = 90;
+	memcpy(sim.signal, signal, sizeof(signal));
+	sim.ir_noise = 0.03;
+	sim.sonar_noise = 1;
+	sim.servo_noise = 0.5;
+	sim.odometry_noise = 0.01;
+	sim.signal_noise = 15;
+	sim.odometry_distance = 2327 / 2560.0; // What calibration.c's defaults expect
+	sim.odometry_angle = 931 / 1024.0;
+	sim.capacity = sim.charge = 2700;
+	sim.seed = 1;
+}
+
+static char add_wall(float x0, float y0, float x1, float y1) {
+	if (sim.wall_count == SIM_MAX_WALLS || (x0 == x1 && y0 == y1))
+		return 0;
+	float* w = sim.walls[sim.wall_count++];
+	w[0] = x0;
+	w[1] = y0;
+	w[2] = x1;
+	w[3] = y1;
+	return 1;
+}
+
+static char add_region(uint8_t surface, float* v) {
+	if (sim.region_count == SIM_MAX_REGIONS)
+		return 0;
+	float* r = sim.regions[sim.region_count];
+	r[0] = fminf(v[0], v[2]);
+	r[1] = fminf(v[1], v[3]);
+	r[2] = fmaxf(v[0], v[2]);
+	r[3] = fmaxf(v[1], v[3]);
+	sim.region_surface[sim.region_count++] = surface;
+	return 1;
+}
+
+static int surface_named(const char* name) {
+	static const char* names[SIM_SURFACES] = {"floor", "white", "red", "cliff"};
+
+	for (int i = 0; i < SIM_SURFACES; i++)
+		if (!strcmp(name, names[i]))
+			return i;
+	return -1;
+}
+
+int sim_load(const char* path) {
+	FILE* in = fopen(path, "r");
+	char text[256];
+	int number = 0;
+
+	defaults();
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(text, sizeof(text), in)) {
+		char word[16], kind[16];
+		float v[4];
+		int ok = 0;
+
+		number++;
+		text[strcspn(text, "#\r\n")] = 0;
+		if (sscanf(text, "%15s", word) != 1)
+			continue;
+
+		if (!strcmp(word, "start")) {
+			ok = sscanf(text, "%*s %f %f %f", &sim.start_x, &sim.start_y, &sim.start_heading) == 3;
+		} else if (!strcmp(word, "wall")) {
+			ok = sscanf(text, "%*s %f %f %f %f", &v[0], &v[1], &v[2], &v[3]) == 4 && add_wall(v[0], v[1], v[2], v[3]);
+		} else if (!strcmp(word, "box")) {
+			ok = sscanf(text, "%*s %f %f %f %f", &v[0], &v[1], &v[2], &v[3]) == 4 && add_wall(v[0], v[1], v[2], v[1]) &&
+			     add_wall(v[2], v[1], v[2], v[3]) && add_wall(v[2], v[3], v[0], v[3]) && add_wall(v[0], v[3], v[0], v[1]);
+		} else if (!strcmp(word, "post")) {
+			if (sscanf(text, "%*s %f %f %15s", &v[0], &v[1], kind) == 3 && sim.post_count < SIM_MAX_POSTS) {
+				float* p = sim.posts[sim.post_count];
+				p[0] = v[0];
+				p[1] = v[1];
+				p[2] = !strcmp(kind, "small") ? (SMALL_OBJECT_SIZE_MIN + SMALL_OBJECT_SIZE_MAX) / 2.0 :
+				       !strcmp(kind, "medium") ? (MEDIUM_OBJECT_SIZE_MIN + MEDIUM_OBJECT_SIZE_MAX) / 2.0 :
+				       !strcmp(kind, "large") ? (LARGE_OBJECT_SIZE_MIN + LARGE_OBJECT_SIZE_MAX) / 2.0 : atof(kind);
+				ok = p[2] > 0;
+				sim.post_count += ok;
+			}
+		} else if (!strcmp(word, "tape")) {
+			int surface = (sscanf(text, "%*s %15s %f %f %f %f", kind, &v[0], &v[1], &v[2], &v[3]) == 5) ? surface_named(kind) : -1;
+			ok = (surface == SIM_WHITE || surface == SIM_RED) && add_region(surface, v);
+		} else if (!strcmp(word, "cliff")) {
+			ok = sscanf(text, "%*s %f %f %f %f", &v[0], &v[1], &v[2], &v[3]) == 4 && add_region(SIM_CLIFF, v);
+		} else if (!strcmp(word, "signal")) {
+			int surface = (sscanf(text, "%*s %15s %f %f %f %f", kind, &v[0], &v[1], &v[2], &v[3]) == 5) ? surface_named(kind) : -1;
+			if (surface >= 0) {
+				for (int i = 0; i < 4; i++)
+					sim.signal[surface][i] = v[i];
+				ok = 1;
+			}
+		} else if (!strcmp(word, "noise")) {
+			if (sscanf(text, "%*s %15s %f", kind, &v[0]) == 2) {
+				float* noise = !strcmp(kind, "ir") ? &sim.ir_noise : !strcmp(kind, "sonar") ? &sim.sonar_noise :
+				               !strcmp(kind, "servo") ? &sim.servo_noise : !strcmp(kind, "odometry") ? &sim.odometry_noise :
+				               !strcmp(kind, "signal") ? &sim.signal_noise : !strcmp(kind, "uart") ? &sim.uart_noise : 0;
+				if (noise) {
+					*noise = v[0];
+					ok = 1;
+				}
+			}
+		} else if (!strcmp(word, "odometry")) {
+			ok = sscanf(text, "%*s %f %f", &sim.odometry_distance, &sim.odometry_angle) == 2;
+		} else if (!strcmp(word, "battery")) {
+			ok = sscanf(text, "%*s %f %f", &sim.capacity, &sim.charge) == 2;
+		} else if (!strcmp(word, "mount")) {
+			ok = sscanf(text, "%*s %f", &sim.mount) == 1;
+		} else if (!strcmp(word, "seed")) {
+			ok = sscanf(text, "%*s %lu", &sim.seed) == 1;
+		} else if (!strcmp(word, "limit")) {
+			ok = sscanf(text, "%*s %f", &sim.limit) == 1;
+		}
+
+		if (!ok) {
+			fprintf(stderr, "%s:%d: not understood: %s\n", path, number, text);
+			fclose(in);
+			return -1;
+		}
+	}
+
+	fclose(in);
+	return 0;
+}
+
+void sim_pose(float* x, float* y, float* heading) {
+	*x = create.x;
+	*y = create.y;
+	*heading = create.heading;
+}
+
+void sim_to_robot(float x, float y, float* robot_x, float* robot_y) {
+	float turn = (90 - sim.start_heading) * M_PI / 180;
+	float dx = x - sim.start_x, dy = y - sim.start_y;
+
+	*robot_x = dx * cosf(turn) - dy * sinf(turn);
+	*robot_y = dx * sinf(turn) + dy * cosf(turn);
+}
+
+/************************************************************************/
+/* USART1                                                               */
+/************************************************************************/
+
+/* Do both ends of the link run at close enough to the same baud rate? Assumes double speed mode, which open_interface.c always uses. */
+static char baud_matches(void) {
+	uint16_t ubrr = (UBRR1H << 8) | UBRR1L;
+	long firmware = FOSC / (8 * (ubrr + 1L));
+
+	return labs(firmware - (long) create.baud) * 1000 / create.baud <= SIM_UART_TOLERANCE;
+}
+
+static void create_byte(uint8_t b);
+
+/* Finishes the firmware's last use of the data register: a write goes to the Create, a read takes the byte out of the receive buffer */
+static void settle(void) {
+	if (!data_touched)
+		return;
+	data_touched = 0;
+
+	if (data_register & SIM_UDR_TAG) {
+		if (rx_count) {
+			rx[0] = rx[1];
+			rx[1] = rx[2];
+			rx_count--;
+		}
+	} else {
+		sim_totals.to_create++;
+		if (baud_matches())
+			create_byte(data_register);
+		else
+			sim_totals.garbled++;
+	}
+}
+
+volatile uint8_t* host_uart1_status(void) {
+	settle();
+	status_register = (1 << UDRE) | (1 << U2X); // Bytes go out as soon as they are written
+	if (rx_count)
+		status_register |= (1 << RXC) | rx[0].flags;
+	return &status_register;
+}
+
+volatile uint16_t* host_uart1_data(void) {
+	settle();
+	data_register = SIM_UDR_TAG | (rx_count ? rx[0].data : 0);
+	data_touched = 1;
+	return &data_register;
+}
+
+/* Byte from the Create reaches the receiver */
+static void arrive(uint8_t data) {
+	uint8_t flags = 0;
+
+	if (!baud_matches() || uniform() < sim.uart_noise) {
+		flags = 1 << FE;
+		data = uniform() * 256;
+		sim_totals.garbled++;
+	}
+	if (rx_count == 3) { // Nowhere to put it
+		rx[2].flags |= 1 << DOR;
+		return;
+	}
+	rx[rx_count].data = data;
+	rx[rx_count].flags = flags;
+	rx_count++;
+}
+
+/* Runs the receive interrupt for every byte waiting, if interrupts are on */
+static void interrupt(void) {
+	while (rx_count && (UCSR1B & (1 << RXCIE1)) && !host_irq_off) {
+		uint8_t waiting = rx_count;
+
+		host_irq_off++;
+		USART1_RX_vect();
+		host_irq_off--;
+		settle();
+		if (rx_count >= waiting)
+			break; // Handler didn't read it
+	}
+}
+
+/* Byte from the Create starts on its way as soon as the ones before it are sent, 10 bits each */
+static void send(uint8_t data) {
+	if (queue_count == SIM_QUEUE)
+		return;
+	if ((long) (line_free - host_ticks) < 0)
+		line_free = host_ticks;
+	line_free += 2500000UL / create.baud;
+
+	int i = (queue_head + queue_count++) % SIM_QUEUE;
+	queue[i].data = data;
+	queue[i].due = line_free;
+	sim_totals.from_create++;
+}
+
+/************************************************************************/
+/* Create                                                               */
+/************************************************************************/
+
+static void put_word(uint8_t* p, uint16_t value) {
+	p[0] = value >> 8;
+	p[1] = value;
+}
+
+static int16_t get_word(const uint8_t* p) {
+	return (int16_t) ((p[0] << 8) | p[1]);
+}
+
+/* Takes a new reading of everything the packets carry */
+static void read_sensors(void) {
+	uint8_t* p = create.group6;
+	float h = create.heading * M_PI / 180;
+
+	memset(p, 0, OI_SENSOR_PACKET_GROUP6_SIZE);
+	p[0] = create.bumps | (sim_totals.fell ? 0x1C : 0); // Stuck in a hole with all its wheels dropped
+	for (int i = 0; i < 4; i++) {
+		float x = create.x + cliff_sensors[i][0] * cosf(h) - cliff_sensors[i][1] * sinf(h);
+		float y = create.y + cliff_sensors[i][0] * sinf(h) + cliff_sensors[i][1] * cosf(h);
+		long signal = sim.signal[floor_at(x, y)][i] + gauss() * sim.signal_noise;
+
+		p[2 + i] = (create.cliffs >> i) & 1;
+		put_word(&p[28 + 2 * i], (signal < 0) ? 0 : (signal > 4095) ? 4095 : signal);
+	}
+	p[10] = 255; // No IR character
+	put_word(&p[12], (int16_t) create.distance);
+	put_word(&p[14], (int16_t) create.angle);
+	put_word(&p[17], 14000 + 3000 * create.charge / sim.capacity);
+	put_word(&p[19], create.current);
+	p[21] = 25;
+	put_word(&p[22], create.charge);
+	put_word(&p[24], sim.capacity);
+	p[40] = create.mode;
+	p[41] = create.song_number;
+	p[42] = (long) (host_ticks - create.song_end) < 0;
+	p[43] = create.stream_count;
+	put_word(&p[44], create.velocity);
+	put_word(&p[46], create.radius);
+	put_word(&p[48], create.target_right);
+	put_word(&p[50], create.target_left);
+	create.sent_distance = create.sent_angle = 0;
+}
+
+/* Copies a packet, or the packets in a group, out of the last reading. Returns its size. */
+static int encode(uint8_t id, uint8_t* out) {
+	int offset = 0, n = 0;
+
+	if (id > 42)
+		return 0;
+	if (id <= 6) {
+		for (uint8_t i = group_first[id]; i <= group_last[id]; i++)
+			n += encode(i, out + n);
+		return n;
+	}
+
+	for (uint8_t i = 7; i < id; i++)
+		offset += packet_size[i];
+	memcpy(out, &create.group6[offset], packet_size[id]);
+	if (id == 19)
+		create.sent_distance = 1;
+	if (id == 20)
+		create.sent_angle = 1;
+	return packet_size[id];
+}
+
+/* Distance and angle start again from 0 once they have been read */
+static void packets_sent(void) {
+	if (create.sent_distance)
+		create.distance -= (int16_t) create.distance;
+	if (create.sent_angle)
+		create.angle -= (int16_t) create.angle;
+}
+
+static void send_stream_frame(void) {
+	uint8_t data[SIM_STREAM_IDS * (OI_SENSOR_PACKET_GROUP6_SIZE + 1)];
+	int n = 0;
+
+	read_sensors();
+	for (int i = 0; i < create.stream_count; i++) {
+		data[n++] = create.stream[i];
+		n += encode(create.stream[i], &data[n]);
+	}
+	packets_sent();
+
+	uint8_t sum = OI_STREAM_HEADER + n;
+	send(OI_STREAM_HEADER);
+	send(n);
+	for (int i = 0; i < n; i++) {
+		send(data[i]);
+		sum += data[i];
+	}
+	send(-sum);
+	sim_totals.frames++;
+}
+
+static void send_packets(const uint8_t* ids, int count) {
+	uint8_t data[OI_SENSOR_PACKET_GROUP6_SIZE];
+
+	read_sensors();
+	for (int i = 0; i < count; i++) {
+		int n = encode(ids[i], data);
+		for (int j = 0; j < n; j++)
+			send(data[j]);
+	}
+	packets_sent();
+}
+
+static void set_wheels(long right, long left) {
+	create.target_right = (right > 500) ? 500 : (right < -500) ? -500 : right;
+	create.target_left = (left > 500) ? 500 : (left < -500) ? -500 : left;
+}
+
+static void stop(void) {
+	set_wheels(0, 0);
+	create.velocity = create.radius = 0;
+}
+
+/* Drops to Passive mode: the wheels stop and any script or wait is abandoned */
+static void passive(void) {
+	create.mode = OI_MODE_PASSIVE;
+	create.script_running = 0;
+	create.wait = 0;
+	stop();
+}
+
+static void drive(int16_t velocity, int16_t radius) {
+	create.velocity = velocity;
+	create.radius = radius;
+	if (radius == (int16_t) 0x8000 || radius == 0x7FFF) // Straight
+		set_wheels(velocity, velocity);
+	else if (radius == -1) // Turn in place clockwise
+		set_wheels(-velocity, velocity);
+	else if (radius == 1)
+		set_wheels(velocity, -velocity);
+	else
+		set_wheels(velocity * (radius + SIM_WHEEL_BASE / 2.0) / radius, velocity * (radius - SIM_WHEEL_BASE / 2.0) / radius);
+}
+
+/* Bytes in the command starting at c, or 0 if more of it has to come in to tell */
+static int command_size(const uint8_t* c, int have) {
+	switch (c[0]) {
+	case OI_OPCODE_BAUD: case OI_OPCODE_MAX: case OI_OPCODE_MOTORS: case OI_OPCODE_PLAY: case OI_OPCODE_SENSORS:
+	case OI_OPCODE_OUTPUTS: case OI_OPCODE_DO_STREAM: case OI_OPCODE_SEND_IR_CHAR: case OI_OPCODE_WAIT_TIME: case OI_OPCODE_WAIT_EVENT:
+		return 2;
+	case OI_OPCODE_WAIT_DISTANCE: case OI_OPCODE_WAIT_ANGLE:
+		return 3;
+	case OI_OPCODE_LEDS: case OI_OPCODE_PWM_MOTORS:
+		return 4;
+	case OI_OPCODE_DRIVE: case OI_OPCODE_DRIVE_WHEELS: case OI_OPCODE_DRIVE_PWM:
+		return 5;
+	case OI_OPCODE_SONG:
+		return (have < 3) ? 0 : 3 + 2 * c[2];
+	case OI_OPCODE_STREAM: case OI_OPCODE_QUERY_LIST: case OI_OPCODE_SCRIPT:
+		return (have < 2) ? 0 : 2 + c[1];
+	default:
+		return 1;
+	}
+}
+
+static void execute(const uint8_t* c) {
+	char driving = (create.mode == OI_MODE_SAFE || create.mode == OI_MODE_FULL);
+
+	switch (c[0]) {
+	case OI_OPCODE_START:
+		passive();
+		break;
+	case OI_OPCODE_BAUD:
+		if (c[1] < sizeof(baud_codes) / sizeof(baud_codes[0]))
+			create.baud = baud_codes[c[1]];
+		break;
+	case OI_OPCODE_CONTROL:
+	case OI_OPCODE_SAFE:
+		create.mode = OI_MODE_SAFE;
+		break;
+	case OI_OPCODE_FULL:
+		create.mode = OI_MODE_FULL;
+		break;
+	case OI_OPCODE_POWER:
+	case OI_OPCODE_SPOT:
+	case OI_OPCODE_CLEAN:
+	case OI_OPCODE_MAX:
+	case OI_OPCODE_FORCEDOCK: // Demos aren't simulated; they just take the Create out of Safe or Full mode
+		passive();
+		break;
+	case OI_OPCODE_DRIVE:
+		if (driving)
+			drive(get_word(&c[1]), get_word(&c[3]));
+		break;
+	case OI_OPCODE_DRIVE_WHEELS:
+		if (driving)
+			set_wheels(get_word(&c[1]), get_word(&c[3]));
+		break;
+	case OI_OPCODE_DRIVE_PWM:
+		if (driving)
+			set_wheels(get_word(&c[1]) * 500L / 255, get_word(&c[3]) * 500L / 255);
+		break;
+	case OI_OPCODE_SONG:
+		if (c[1] < SIM_SONGS) {
+			unsigned long length = 0;
+			for (int i = 0; i < c[2]; i++)
+				length += c[4 + 2 * i]; // 64ths of a second
+			create.song_length[c[1]] = length * 250000UL / 64;
+		}
+		break;
+	case OI_OPCODE_PLAY:
+		if (c[1] < SIM_SONGS) {
+			create.song_number = c[1];
+			create.song_end = host_ticks + create.song_length[c[1]];
+		}
+		break;
+	case OI_OPCODE_SENSORS:
+		send_packets(&c[1], 1);
+		break;
+	case OI_OPCODE_QUERY_LIST:
+		send_packets(&c[2], c[1]);
+		break;
+	case OI_OPCODE_STREAM:
+		create.stream_count = (c[1] > SIM_STREAM_IDS) ? SIM_STREAM_IDS : c[1];
+		memcpy(create.stream, &c[2], create.stream_count);
+		create.streaming = create.stream_count > 0;
+		create.next_frame = host_ticks + SIM_STREAM_PERIOD;
+		break;
+	case OI_OPCODE_DO_STREAM:
+		if (c[1] && !create.streaming)
+			create.next_frame = host_ticks + SIM_STREAM_PERIOD;
+		create.streaming = c[1] && create.stream_count;
+		break;
+	case OI_OPCODE_SCRIPT:
+		create.script_length = (c[1] > SIM_SCRIPT_MAX) ? SIM_SCRIPT_MAX : c[1];
+		memcpy(create.script, &c[2], create.script_length);
+		break;
+	case OI_OPCODE_PLAY_SCRIPT:
+		create.script_pc = 0;
+		create.script_running = create.script_length > 0;
+		break;
+	case OI_OPCODE_SHOW_SCRIPT:
+		send(create.script_length);
+		for (int i = 0; i < create.script_length; i++)
+			send(create.script[i]);
+		break;
+	case OI_OPCODE_WAIT_TIME:
+		create.wait = c[0];
+		create.wait_until = host_ticks + c[1] * 25000UL; // Tenths of a second
+		break;
+	case OI_OPCODE_WAIT_DISTANCE:
+	case OI_OPCODE_WAIT_ANGLE:
+		create.wait = c[0];
+		create.wait_target = get_word(&c[1]);
+		create.wait_progress = 0;
+		break;
+	case OI_OPCODE_WAIT_EVENT:
+		create.wait = c[0];
+		create.wait_target = (int8_t) c[1];
+		break;
+	default: // LEDs, motors, outputs, IR characters, and anything unknown
+		break;
+	}
+}
+
+/* Is a wait event happening? Negative codes are the event not happening. */
+static char event(int code) {
+	char on;
+
+	switch (abs(code)) {
+	case 1: case 2: case 3: case 4: on = sim_totals.fell; break;   // Wheel drops
+	case 5: on = create.bumps != 0; break;
+	case 6: on = (create.bumps & 0x02) != 0; break;
+	case 7: on = (create.bumps & 0x01) != 0; break;
+	case 10: on = create.cliffs != 0; break;
+	case 11: case 12: case 13: case 14: on = (create.cliffs >> (abs(code) - 11)) & 1; break;
+	case 22: on = create.mode == OI_MODE_PASSIVE; break;
+	default: on = 0; break; // Walls, buttons, the dock, and cargo bay inputs never happen here
+	}
+	return (code < 0) ? !on : on;
+}
+
+/* Is a wait command still holding things up? */
+static char waiting(void) {
+	char done;
+
+	switch (create.wait) {
+	case 0:
+		return 0;
+	case OI_OPCODE_WAIT_TIME:
+		done = (long) (host_ticks - create.wait_until) >= 0;
+		break;
+	case OI_OPCODE_WAIT_EVENT:
+		done = event(create.wait_target);
+		break;
+	default: // Distance or angle
+		done = (create.wait_target >= 0) ? create.wait_progress >= create.wait_target : create.wait_progress <= create.wait_target;
+		break;
+	}
+	if (done)
+		create.wait = 0;
+	return !done;
+}
+
+static void run_script(void) {
+	for (int n = 0; n < SIM_SCRIPT_MAX && create.script_running && !waiting(); n++) { // A script that loops without waiting gets one pass per step
+		int left = create.script_length - create.script_pc;
+		const uint8_t* c = &create.script[create.script_pc];
+		int size = left ? command_size(c, left) : 0;
+
+		if (size == 0 || size > left) { // Ran off the end
+			create.script_running = 0;
+			break;
+		}
+		create.script_pc += size;
+		execute(c);
+	}
+}
+
+/* Byte of a command from the firmware. Ignored until the OI is started, and while a script or wait runs. */
+static void create_byte(uint8_t b) {
+	create.command[create.command_length++] = b;
+
+	int size = command_size(create.command, create.command_length);
+	if (create.command_length == SIM_COMMAND_MAX)
+		size = create.command_length; // Can't be right; drop it
+	if (size == 0 || create.command_length < size)
+		return;
+	create.command_length = 0;
+
+	if (create.mode == OI_MODE_OFF && create.command[0] != OI_OPCODE_START)
+		return;
+	if (create.script_running || waiting())
+		return;
+	execute(create.command);
+}
+
+static float approach(float speed, float target, float change) {
+	if (speed < target)
+		return (speed + change > target) ? target : speed + change;
+	return (speed - change < target) ? target : speed - change;
+}
+
+/* One SIM_STEP of the world */
+static void step(void) {
+	float dt = SIM_STEP / 250000.0;
+	float contact = 0;
+
+	create.right = approach(create.right, sim_totals.fell ? 0 : create.target_right, SIM_ACCEL * dt);
+	create.left = approach(create.left, sim_totals.fell ? 0 : create.target_left, SIM_ACCEL * dt);
+
+	/* Move, unless that would push further into a wall or post */
+	float turn = (create.right - create.left) / SIM_WHEEL_BASE * dt * 180 / M_PI; // degrees
+	float forward = (create.right + create.left) / 2 * dt / 10;                   // cm
+	float middle = (create.heading + turn / 2) * M_PI / 180;
+	float x = create.x + forward * cosf(middle), y = create.y + forward * sinf(middle);
+	float reported = forward * 10 * sim.odometry_distance * create.distance_scale; // Blocked, the wheels slip and the encoders still count
+
+	if (forward != 0) {
+		float now = overlap(create.x, create.y, &contact);
+		float next = overlap(x, y, &contact);
+		if (next <= 0 || next <= now) {
+			create.x = x;
+			create.y = y;
+			sim_totals.driven += fabsf(forward);
+		}
+	}
+	create.heading += turn;
+	if (create.heading < 0)
+		create.heading += 360;
+	else if (create.heading >= 360)
+		create.heading -= 360;
+	create.distance += reported;
+	create.angle += turn * sim.odometry_angle * create.angle_scale;
+	if (create.wait == OI_OPCODE_WAIT_DISTANCE)
+		create.wait_progress += reported;
+	else if (create.wait == OI_OPCODE_WAIT_ANGLE)
+		create.wait_progress += turn * sim.odometry_angle * create.angle_scale;
+
+	/* Bumper, for anything touching the front half */
+	uint8_t bumps = 0;
+	if (overlap(create.x, create.y, &contact) > -0.3) {
+		float side = contact - create.heading;
+		while (side > 180)
+			side -= 360;
+		while (side < -180)
+			side += 360;
+		if (side > 10 && side <= 90)
+			bumps = 0x02;
+		else if (side < -10 && side >= -90)
+			bumps = 0x01;
+		else if (fabsf(side) <= 10)
+			bumps = 0x03;
+	}
+	if (bumps && !create.bumps)
+		sim_totals.bumps++;
+	create.bumps = bumps;
+
+	/* Cliff sensors, and the middle of the Create going over the edge */
+	float h = create.heading * M_PI / 180;
+	uint8_t cliffs = 0;
+	char red = 0;
+	for (int i = 0; i < 4; i++) {
+		float cx = create.x + cliff_sensors[i][0] * cosf(h) - cliff_sensors[i][1] * sinf(h);
+		float cy = create.y + cliff_sensors[i][0] * sinf(h) + cliff_sensors[i][1] * cosf(h);
+		uint8_t surface = floor_at(cx, cy);
+		if (surface == SIM_CLIFF)
+			cliffs |= 1 << i;
+		if (surface == SIM_RED)
+			red = 1;
+	}
+	if (cliffs & ~create.cliffs)
+		sim_totals.cliffs++;
+	create.cliffs = cliffs;
+
+	if (floor_at(create.x, create.y) == SIM_CLIFF)
+		sim_totals.fell = 1;
+	if (red && !sim_totals.reached_red) {
+		sim_totals.reached_red = 1;
+		sim_totals.red_ticks = host_ticks;
+	}
+
+	/* Safe mode stops for a cliff ahead or a wheel drop */
+	if (create.mode == OI_MODE_SAFE && ((cliffs && create.target_right + create.target_left > 0) || sim_totals.fell)) {
+		passive();
+		sim_totals.safety_stops++;
+	}
+
+	/* Battery */
+	create.current = -(SIM_IDLE_CURRENT + SIM_DRIVE_CURRENT * (fabsf(create.right) + fabsf(create.left)));
+	create.charge += create.current * dt / 3600;
+	if (create.charge < 0)
+		create.charge = 0;
+
+	/* Servo */
+	float servo_step = SIM_SERVO_RATE * dt;
+	create.servo = approach(create.servo, host_servo_degrees, servo_step);
+
+	run_script();
+
+	if (create.streaming && (long) (host_ticks - create.next_frame) >= 0) {
+		send_stream_frame();
+		create.next_frame += SIM_STREAM_PERIOD;
+	}
+}
+
+void sim_start(void) {
+	memset(&create, 0, sizeof(create));
+	memset(&sim_totals, 0, sizeof(sim_totals));
+	random_state = sim.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	create.mode = OI_MODE_OFF;
+	create.baud = 57600; // What the Create starts at
+	create.x = sim.start_x;
+	create.y = sim.start_y;
+	create.heading = sim.start_heading;
+	create.distance_scale = 1 + gauss() * sim.odometry_noise;
+	create.angle_scale = 1 + gauss() * sim.odometry_noise;
+	create.charge = sim.charge;
+	create.servo = 90;
+
+	queue_head = queue_count = 0;
+	rx_count = 0;
+	data_touched = 0;
+	line_free = host_ticks;
+	next_step = host_ticks + SIM_STEP;
+	host_poll_ticks = SIM_POLL;
+}
+
+/************************************************************************/
+/* Data source (host.h)                                                 */
+/************************************************************************/
+
+void host_run(void) {
+	static char running;
+
+	if (running) // Called again by the clock reads in the interrupt handler
+		return;
+	running = 1;
+
+	settle();
+	interrupt(); // Bytes held off by an atomic block
+
+	unsigned long until = host_ticks;
+	while (1) {
+		unsigned long t = next_step;
+		char byte = queue_count && (long) (queue[queue_head].due - next_step) < 0;
+
+		if (byte)
+			t = queue[queue_head].due;
+		if ((long) (t - until) > 0)
+			break;
+
+		host_ticks = t;
+		if (byte) {
+			uint8_t data = queue[queue_head].data;
+			queue_head = (queue_head + 1) % SIM_QUEUE;
+			queue_count--;
+			arrive(data);
+			interrupt();
+		} else {
+			step();
+			next_step += SIM_STEP;
+		}
+	}
+	host_ticks = until;
+
+	running = 0;
+	if (sim.limit > 0 && host_ticks > sim.limit * 250000) {
+		fprintf(stderr, "sim: time limit reached\n");
+		host_finish();
+	}
+}
+
+unsigned long host_next_event(void) {
+	if (queue_count && (long) (queue[queue_head].due - next_step) < 0)
+		return queue[queue_head].due;
+	return next_step; // A step can start a stream frame
+}
+
+int host_next_sample(float degrees, unsigned int* ir_adc, unsigned int* sonar_ticks) {
+	float h = create.heading * M_PI / 180;
+	float x = create.x + sim.mount * cosf(h), y = create.y + sim.mount * sinf(h);
+	float bearing = create.heading - 90 + create.servo + gauss() * sim.servo_noise; // Servo 90 is straight ahead
+
+	/* IR: one narrow ray. Too close, the reading folds back and looks farther. */
+	float ir = cast(x, y, bearing, SIM_IR_RANGE, 0) * (1 + gauss() * sim.ir_noise);
+	if (ir < 1)
+		ir = 1;
+	if (ir < SIM_IR_NEAR)
+		ir = SIM_IR_NEAR * SIM_IR_NEAR / ir;
+	double adc = pow(SIM_IR_K / ir, 1 / SIM_IR_P);
+	*ir_adc = (adc > 1023) ? 1023 : (adc < 1) ? 1 : adc;
+
+	/* SONAR: the nearest echo across the cone */
+	float sonar = SIM_SONAR_RANGE;
+	for (int a = -SIM_SONAR_CONE; a <= SIM_SONAR_CONE; a += 3) {
+		float d = cast(x, y, bearing + a, SIM_SONAR_RANGE, 1);
+		if (d < sonar)
+			sonar = d;
+	}
+	if (sonar < SIM_SONAR_RANGE) {
+		sonar += gauss() * sim.sonar_noise;
+		*sonar_ticks = (sonar < 2) ? 2 / 0.0686 : sonar / 0.0686; // 0.0686 cm per 4 us tick there and back
+	} else {
+		*sonar_ticks = SIM_SONAR_TIMEOUT;
+	}
+
+	sim_totals.samples++;
+	return 1;
+}
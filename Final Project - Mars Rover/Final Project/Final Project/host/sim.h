@@ -0,0 +1,196 @@
+/*! \file sim.h
+    \brief Simulated arena and Create for the host build.
+
+	The arena is a flat floor with walls, posts, tape, and cliffs, loaded from a text file. The
+	Create in it is driven by the bytes the real open_interface.c writes to USART1: it understands
+	the Open Interface opcodes 128 to 158, runs scripts, and answers with sensor packets and streams
+	encoded the way the real one does. Between bytes it moves as a differential drive with limited
+	acceleration, bumps into walls and posts, and reads its cliff sensors off the floor under them.
+
+	The servo turns at a limited rate, and the IR and SONAR readings are ray cast from where it
+	points: the IR along one narrow ray, the SONAR across a cone, missing walls it meets at too
+	shallow an angle. Readings, odometry, and the serial link all take configurable noise from a
+	seeded generator, so a run can be repeated exactly.
+
+	Simulated time only moves when the firmware waits or reads the clock, so a run takes as long as
+	the firmware's own computation and goes many times faster than real time.
+
+	Arena files have one item per line, in cm and degrees, x east and y north. # starts a comment.
+	\verbatim
+	start <x> <y> <heading>                   Where the robot starts. Default 0 0 90, the firmware's own origin.
+	wall <x0> <y0> <x1> <y1>
+	box <x0> <y0> <x1> <y1>                   Four walls around a rectangle
+	post <x> <y> small|medium|large|<diameter>  Sizes are the middle of the *_OBJECT_SIZE classes
+	tape white|red <x0> <y0> <x1> <y1>        Rectangle of tape; later items cover earlier ones
+	cliff <x0> <y0> <x1> <y1>                 Rectangle with no floor
+	signal floor|white|red|cliff <left> <front left> <front right> <right>  Cliff sensor signals
+	noise ir <fraction>                       Standard deviation of each IR reading, relative to its distance
+	noise sonar <cm>                          Standard deviation of each SONAR reading
+	noise servo <degrees>                     Standard deviation of where the servo actually points
+	noise odometry <fraction>                 Standard deviation of the Create's wheel size and wheel base error
+	noise signal <units>                      Standard deviation of each cliff sensor signal
+	noise uart <probability>                  Chance of each byte from the Create arriving with a framing error
+	odometry <distance> <angle>               What the Create reports per true mm and degree
+	battery <capacity> <charge>               In mAh
+	mount <cm>                                How far ahead of the middle of the Create the sensors are
+	seed <n>
+	limit <seconds>                           Longest a run may take in simulated time, 0 for no limit
+	\endverbatim
+*/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <inttypes.h>
+
+/*! \def SIM_MAX_WALLS
+	\brief Walls an arena can have
+*/
+#define SIM_MAX_WALLS 64
+/*! \def SIM_MAX_POSTS
+	\brief Posts an arena can have
+*/
+#define SIM_MAX_POSTS 32
+/*! \def SIM_MAX_REGIONS
+	\brief Tape and cliff rectangles an arena can have
+*/
+#define SIM_MAX_REGIONS 32
+
+/*! \def SIM_FLOOR
+	\brief Bare floor
+*/
+#define SIM_FLOOR 0
+/*! \def SIM_WHITE
+	\brief White tape
+*/
+#define SIM_WHITE 1
+/*! \def SIM_RED
+	\brief Red tape, the retrieval zone
+*/
+#define SIM_RED 2
+/*! \def SIM_CLIFF
+	\brief No floor
+*/
+#define SIM_CLIFF 3
+/*! \def SIM_SURFACES
+	\brief Kinds of floor
+*/
+#define SIM_SURFACES 4
+
+/*! \def SIM_RADIUS
+	\brief Radius of the Create in cm
+*/
+#define SIM_RADIUS 16.5
+/*! \def SIM_WHEEL_BASE
+	\brief Distance between the wheels in mm
+*/
+#define SIM_WHEEL_BASE 258
+/*! \def SIM_ACCEL
+	\brief Fastest a wheel changes speed, in mm/s per second
+*/
+#define SIM_ACCEL 2000
+/*! \def SIM_STEP
+	\brief Time between physics steps, in timer 1 ticks (1 ms)
+*/
+#define SIM_STEP 250
+/*! \def SIM_POLL
+	\brief Time each uptime_ticks() call takes, in timer 1 ticks
+*/
+#define SIM_POLL 10
+/*! \def SIM_STREAM_PERIOD
+	\brief Time between stream frames, in timer 1 ticks (15 ms)
+*/
+#define SIM_STREAM_PERIOD (15 * 250UL)
+/*! \def SIM_SERVO_RATE
+	\brief Speed of the servo in degrees per second
+*/
+#define SIM_SERVO_RATE 300
+/*! \def SIM_IR_RANGE
+	\brief Farthest the IR ray is cast, in cm. Nothing there reads as this far.
+*/
+#define SIM_IR_RANGE 150
+/*! \def SIM_IR_NEAR
+	\brief Distance in cm under which the IR reading folds back and reads farther again
+*/
+#define SIM_IR_NEAR 8
+/*! \def SIM_SONAR_RANGE
+	\brief Farthest SONAR echo in cm
+*/
+#define SIM_SONAR_RANGE 300
+/*! \def SIM_SONAR_CONE
+	\brief Half width of the SONAR beam in degrees
+*/
+#define SIM_SONAR_CONE 15
+/*! \def SIM_SONAR_INCIDENCE
+	\brief Largest angle from a wall's normal that still echoes back, in degrees
+*/
+#define SIM_SONAR_INCIDENCE 50
+/*! \def SIM_SONAR_TIMEOUT
+	\brief Echo time when nothing answers, in timer 1 ticks (18.5 ms)
+*/
+#define SIM_SONAR_TIMEOUT 4625
+/*! \def SIM_UART_TOLERANCE
+	\brief Largest difference between the two ends' baud rates that still gets bytes through, in tenths of a percent
+*/
+#define SIM_UART_TOLERANCE 30
+
+//! Everything an arena file sets.
+typedef struct {
+	float start_x, start_y, start_heading; /*!< cm, cm, degrees */
+	float walls[SIM_MAX_WALLS][4];          /*!< x0, y0, x1, y1 */
+	uint8_t wall_count;
+	float posts[SIM_MAX_POSTS][3];          /*!< x, y, diameter */
+	uint8_t post_count;
+	float regions[SIM_MAX_REGIONS][4];      /*!< x0, y0, x1, y1 */
+	uint8_t region_surface[SIM_MAX_REGIONS]; /*!< SIM_WHITE, SIM_RED, or SIM_CLIFF */
+	uint8_t region_count;
+	uint16_t signal[SIM_SURFACES][4];       /*!< Cliff sensor signal over each surface, left to right */
+	float ir_noise;
+	float sonar_noise;
+	float servo_noise;
+	float odometry_noise;
+	float signal_noise;
+	float uart_noise;
+	float odometry_distance;                /*!< Reported mm per true mm */
+	float odometry_angle;                   /*!< Reported degrees per true degree */
+	float capacity, charge;                 /*!< mAh */
+	float mount;                            /*!< cm */
+	unsigned long seed;
+	float limit;                            /*!< seconds */
+} sim_arena;
+
+//! What happened in a run.
+typedef struct {
+	unsigned long to_create;   /*!< Bytes the firmware sent the Create */
+	unsigned long from_create; /*!< Bytes the Create sent the firmware */
+	unsigned long garbled;     /*!< Bytes lost to a baud rate mismatch or noise, either way */
+	unsigned long frames;      /*!< Stream frames sent */
+	unsigned long samples;     /*!< IR and SONAR samples taken */
+	unsigned int bumps;        /*!< Times the Create ran into something */
+	unsigned int cliffs;       /*!< Times a cliff sensor went over a cliff */
+	unsigned int safety_stops; /*!< Times Safe mode stopped the Create */
+	char fell;                 /*!< Drove over a cliff and is stuck */
+	char reached_red;          /*!< A cliff sensor has been over red tape */
+	unsigned long red_ticks;   /*!< host_ticks when it first was */
+	float driven;              /*!< cm */
+} sim_stats;
+
+/// The arena being simulated.
+extern sim_arena sim;
+
+/// Counts for the run so far.
+extern sim_stats sim_totals;
+
+/// Reads an arena file into sim, over the defaults. Prints what is wrong and returns -1 if it can't.
+int sim_load(const char* path);
+
+/// Puts the Create at the start, powered on but not started, and resets the counts. Call before the firmware runs.
+void sim_start(void);
+
+/// Where the Create really is, in arena cm and degrees.
+void sim_pose(float* x, float* y, float* heading);
+
+/// Converts arena coordinates to the frame the firmware tracks the robot in, which starts at 0, 0 facing 90 degrees.
+void sim_to_robot(float x, float y, float* robot_x, float* robot_y);
+
+#endif
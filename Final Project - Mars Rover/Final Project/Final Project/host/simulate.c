@@ -0,0 +1,196 @@
+/*
+ * simulate.c
+ *
+ * Runs the unmodified firmware, Open Interface driver included, against the simulated arena and
+ * Create in sim.c. Everything the robot would send over bluetooth goes to stdout, as with replay.c;
+ * a summary of the run goes to stderr. With -j, one line of JSON for the benchmarks in host/bench
+ * goes to stdout instead of either.
+ *
+ * Build and run from the project directory:
+ *   gcc -std=gnu99 -O2 -funsigned-char -funsigned-bitfields -DNPROFILE -DHOST_SIM -Dmain=firmware_main -Ihost
+ *       -o simulate host/simulate.c host/sim.c host/host_hw.c open_interface.c main.c object_tracking.c
+ *       scan.c sensor_fusion.c geometry.c fixed_math.c calibration.c profile.c compress.c surface.c
+ *       script.c sequence.c lookahead.c pose.c explore.c idle.c energy.c -lm
+ *   ./simulate [-s seed] [-t seconds] [-j name] host/arenas/field.arena commands > output.txt
+ *
+ * commands are the operator's keystrokes, handed over one at a time as the firmware reads them; "e"
+ * explores, "q" scans, "{M100}" drives a sequence. A 'p' follows so the final object table is
+ * printed. -s and -t override the arena's seed and time limit, so a batch can loop over seeds:
+ *   for s in $(seq 1000); do ./simulate -s $s -t 300 field.arena e > /dev/null; done
+ *
+ * The objects in that last table are matched to the arena's posts to measure how far off the
+ * firmware put them. An object counts as a post's if it is the nearest one within SIM_MATCH cm.
+ */
+
+#undef main // Only the firmware's main is renamed
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "host.h"
+#include "sim.h"
+
+#define SIM_MATCH 30      // Farthest an object can be from a post and still be that post, in cm
+#define SIM_OBJECTS 64    // Objects kept from the final table
+
+static const char* commands = "";
+static const char* json_name;  // Name of the run for -j, or 0 for the text summary
+static int final_report_sent;
+static struct timespec started;
+static unsigned long bluetooth_out, bluetooth_in;
+static char line[256];         // Bluetooth line being collected
+static int line_length;
+static float objects[SIM_OBJECTS][2];
+static int object_count;
+
+int host_next_command(void) {
+	if (*commands) {
+		bluetooth_in++;
+		return (unsigned char) *commands++;
+	}
+	if (!final_report_sent) {
+		final_report_sent = 1;
+		bluetooth_in++;
+		return 'p';
+	}
+	return -1;
+}
+
+/* Keeps where every object in the final table is, except tape and cliffs, which aren't posts */
+static void read_line(const char* text) {
+	const char* at = strstr(text, " Coordinates: (");
+	float x, y;
+
+	if (!final_report_sent || !at || strstr(text, "Tape") || strstr(text, "Cliff") || object_count == SIM_OBJECTS)
+		return;
+	if (sscanf(at, " Coordinates: (%f, %f)", &x, &y) == 2) {
+		objects[object_count][0] = x;
+		objects[object_count][1] = y;
+		object_count++;
+	}
+}
+
+void host_bluetooth(const char* data, int length) {
+	if (!json_name)
+		fwrite(data, 1, length, stdout);
+	bluetooth_out += length;
+
+	for (int i = 0; i < length; i++) {
+		if (data[i] == '\n' || line_length == sizeof(line) - 1) {
+			line[line_length] = 0;
+			read_line(line);
+			line_length = 0;
+		} else {
+			line[line_length++] = data[i];
+		}
+	}
+}
+
+/* Matches the final table to the posts. Returns the posts found and sets their mean error in cm. */
+static int match_posts(float* error) {
+	int matched = 0;
+	float sum = 0;
+
+	for (int i = 0; i < sim.post_count; i++) {
+		float px, py, best = SIM_MATCH;
+		sim_to_robot(sim.posts[i][0], sim.posts[i][1], &px, &py);
+		for (int j = 0; j < object_count; j++) {
+			float d = hypotf(objects[j][0] - px, objects[j][1] - py);
+			if (d < best)
+				best = d;
+		}
+		if (best < SIM_MATCH) {
+			matched++;
+			sum += best;
+		}
+	}
+	*error = matched ? sum / matched : 0;
+	return matched;
+}
+
+static void print_json(double simulated, double wall) {
+	float error;
+	int matched = match_posts(&error);
+
+	printf("{\"mission\": \"%s\", \"seed\": %lu, \"simulated_s\": %.3f, \"wall_s\": %.4f, ", json_name, sim.seed, simulated, wall);
+	if (sim_totals.reached_red)
+		printf("\"goal_s\": %.3f, ", sim_totals.red_ticks / 250000.0);
+	else
+		printf("\"goal_s\": null, ");
+	printf("\"create_bytes_out\": %lu, \"create_bytes_in\": %lu, \"bluetooth_bytes_out\": %lu, \"bluetooth_bytes_in\": %lu, ",
+	       sim_totals.to_create, sim_totals.from_create, bluetooth_out, bluetooth_in);
+	printf("\"cpu_busy_pct\": %.1f, \"samples\": %lu, \"samples_per_s\": %.1f, ", 100 * (1 - host_idle_ticks / 250000.0 / simulated), sim_totals.samples,
+	       sim_totals.samples / simulated);
+	printf("\"objects\": %d, \"posts\": %d, \"posts_found\": %d, \"position_error_cm\": %.1f, ", object_count, sim.post_count, matched, error);
+	printf("\"driven_cm\": %.0f, \"bumps\": %u, \"cliffs\": %u, \"fell\": %s}\n", sim_totals.driven, sim_totals.bumps, sim_totals.cliffs, sim_totals.fell ? "true" : "false");
+}
+
+void host_finish(void) {
+	struct timespec now;
+	float x, y, heading, robot_x, robot_y, error;
+	double simulated = host_ticks / 250000.0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double wall = (now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9;
+
+	if (json_name) {
+		print_json(simulated, wall);
+		exit(0);
+	}
+
+	fflush(stdout);
+	sim_pose(&x, &y, &heading);
+	sim_to_robot(x, y, &robot_x, &robot_y);
+	fprintf(stderr, "sim: %.3f s simulated in %.3f s, %.0f times real time\n", simulated, wall, simulated / (wall > 0 ? wall : 1e-9));
+	fprintf(stderr, "sim: ended at %.1f %.1f facing %.1f (%.1f %.1f in the robot's frame)\n", x, y, heading, robot_x, robot_y);
+	fprintf(stderr, "sim: drove %.0f cm, %u bumps, %u cliffs, %u safety stops%s\n", sim_totals.driven, sim_totals.bumps, sim_totals.cliffs, sim_totals.safety_stops,
+	        sim_totals.fell ? ", fell over a cliff" : "");
+	fprintf(stderr, "sim: Create link %lu bytes out, %lu in, %lu garbled, %lu frames; %lu samples\n", sim_totals.to_create, sim_totals.from_create, sim_totals.garbled,
+	        sim_totals.frames, sim_totals.samples);
+	fprintf(stderr, "sim: bluetooth %lu bytes out, %lu in; CPU %.1f%% busy\n", bluetooth_out, bluetooth_in, 100 * (1 - host_idle_ticks / 250000.0 / simulated));
+	int matched = match_posts(&error);
+	fprintf(stderr, "sim: %d of %d posts found, %.1f cm off on average\n", matched, sim.post_count, error);
+	if (sim_totals.reached_red)
+		fprintf(stderr, "sim: reached the red tape at %.3f s\n", sim_totals.red_ticks / 250000.0);
+	else
+		fprintf(stderr, "sim: never reached the red tape\n");
+	exit(0);
+}
+
+int firmware_main(void);
+
+int main(int argc, char** argv) {
+	long seed = -1;
+	float limit = -1;
+	int option;
+
+	while ((option = getopt(argc, argv, "s:t:j:")) != -1) {
+		if (option == 's')
+			seed = atol(optarg);
+		else if (option == 't')
+			limit = atof(optarg);
+		else if (option == 'j')
+			json_name = optarg;
+		else
+			return 1;
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "usage: %s [-s seed] [-t seconds] [-j name] arena [commands]\n", argv[0]);
+		return 1;
+	}
+
+	if (sim_load(argv[optind]) < 0)
+		return 1;
+	if (seed >= 0)
+		sim.seed = seed;
+	if (limit >= 0)
+		sim.limit = limit;
+	if (optind + 1 < argc)
+		commands = argv[optind + 1];
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	sim_start();
+	return firmware_main();
+}
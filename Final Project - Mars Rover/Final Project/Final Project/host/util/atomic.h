@@ -0,0 +1,25 @@
+/*
+ * util/atomic.h (host build)
+ *
+ * Atomic blocks hold off the simulated interrupts (see sim.c) the same way avr-libc's do, including
+ * when the block is left with return or break. The replay build never interrupts.
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+extern volatile int host_irq_off;
+
+static inline int host_irq_disable(void) {
+	host_irq_off++;
+	return 1;
+}
+
+static inline void host_irq_restore(int* unused) {
+	host_irq_off--;
+}
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (int host_atomic_once __attribute__((__cleanup__(host_irq_restore))) = host_irq_disable(); host_atomic_once; host_atomic_once = 0)
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * idle.c
+ *
+ * Low-power idle and CPU duty cycle. See idle.h.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include "util.h"
+#include "idle.h"
+
+static unsigned long idle_total;  // Timer 1 ticks spent asleep
+static unsigned long report_time; // uptime_ticks() at the last report
+static unsigned long report_idle; // idle_total at the last report
+
+void idle_sleep(void) {
+	unsigned long start = uptime_ticks();
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei(); // Takes effect after the next instruction, so an interrupt can't slip in before the sleep
+	sleep_cpu();
+	cli();
+	sleep_disable();
+
+	idle_total += uptime_ticks() - start;
+}
+
+void idle_alarm(unsigned long deadline) {
+	uint8_t sreg = SREG;
+
+	cli(); // OCR1A shares the 16-bit temp register with the ICR1 reads in the PING interrupt
+	OCR1A = (uint16_t) deadline;
+	TIFR = (1 << OCF1A); // Forget an old match
+	TIMSK |= (1 << OCIE1A);
+	SREG = sreg;
+}
+
+/* One shot; it is only there to wake idle_sleep() */
+ISR(TIMER1_COMPA_vect) {
+	TIMSK &= ~(1 << OCIE1A);
+}
+
+unsigned long idle_ticks(void) {
+	return idle_total;
+}
+
+void idle_report(void) {
+	char buffer[100];
+	unsigned long now = uptime_ticks();
+	unsigned long period = now - report_time;
+	unsigned long idle = idle_total - report_idle;
+	unsigned int busy = period ? 1000 - (unsigned int) (idle * 1000.0 / period) : 0; // Tenths of a percent
+
+	sprintf_P(buffer, PSTR("\r\nCPU busy %u.%u%% of the last %lu ms, idle %lu ms\r\n"), busy / 10, busy % 10, period / 250, idle / 250);
+	send_message(buffer);
+
+	report_time = now;
+	report_idle = idle_total;
+}
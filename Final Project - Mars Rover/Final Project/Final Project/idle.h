@@ -0,0 +1,47 @@
+/*! \file idle.h
+    \brief Low-power idle and CPU duty cycle.
+
+	Every wait for an event (a byte from the operator or the Create, a millisecond tick, the end of
+	an ADC conversion) puts the CPU in idle sleep instead of spinning. Idle sleep stops the CPU clock
+	but leaves the timers, USARTs, and ADC running, so any of their interrupts wakes it. A wait
+	that has to end by a deadline sets an alarm on Timer1's compare unit A first, so it wakes even
+	if nothing else happens.
+
+	A wait looks like this, so an interrupt that arrives between the check and the sleep still
+	wakes it:
+	\code
+	cli();
+	while (!event)
+		idle_sleep();
+	sei();
+	\endcode
+
+	The time spent asleep is added up, which gives how busy the CPU really is.
+*/
+
+#ifndef IDLE_H
+#define IDLE_H
+
+/// Sleeps until the next interrupt.
+/**
+* Call with interrupts disabled. They are enabled for the sleep, the interrupt that ends it runs, and they are disabled again before it returns.
+*/
+void idle_sleep(void);
+
+/// Makes sure idle_sleep() wakes by a deadline.
+/**
+* The alarm goes off once, and only the low 16 bits are used, so the deadline has to be less than 262 ms away.
+* @param deadline uptime_ticks() value to wake at
+*/
+void idle_alarm(unsigned long deadline);
+
+/// Total time spent asleep.
+/**
+* @return timer 1 ticks (4 us each)
+*/
+unsigned long idle_ticks(void);
+
+/// Sends the share of the time since the last report the CPU was awake over bluetooth, then starts a new period.
+void idle_report(void);
+
+#endif
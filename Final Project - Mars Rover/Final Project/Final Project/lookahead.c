@@ -0,0 +1,155 @@
+/*
+ * lookahead.c
+ *
+ * Forward arc scanning while driving. See lookahead.h.
+ */
+
+#include <stdlib.h>
+#include "util.h"
+#include "scan.h"
+#include "sensor_fusion.h"
+#include "geometry.h"
+#include "pose.h"
+#include "lookahead.h"
+
+//! A sample waiting for its SONAR echo.
+typedef struct {
+	uint8_t angle;  /*!< Servo angle it was taken at */
+	uint16_t ir_mm; /*!< IR reading */
+	unsigned long time; /*!< uptime_ticks() when it was taken */
+} look_sample;
+
+//! Object being built from neighboring samples.
+typedef struct {
+	uint8_t count;  /*!< Samples in it, 0 if none */
+	uint8_t start;  /*!< First and last servo angle */
+	uint8_t end;
+	int last;       /*!< Fused range of the last sample */
+	long range_sum; /*!< Sums to average over the samples */
+	long ir_sum;
+	float x_sum;
+	float y_sum;
+	char edge;      /*!< Reaches the end of the arc, so part of it may be outside */
+} look_segment;
+
+static char enabled;
+static float servo;           // Servo angle now
+static int8_t step;           // LOOK_STEP or -LOOK_STEP
+static look_sample pending;
+static char have_pending;
+static look_segment segment;
+static uint8_t in_path;       // Samples in a row that were in the robot's path
+
+void look_enable(char on) {
+	enabled = on;
+}
+
+char look_enabled(void) {
+	return enabled;
+}
+
+void look_begin(void) {
+	servo = LOOK_ARC_MIN;
+	step = LOOK_STEP;
+	have_pending = 0;
+	segment.count = 0;
+	in_path = 0;
+	move_servo(&servo);
+	wait_ms(LOOK_SETTLE);
+}
+
+/* Adds the finished segment to the tracker, unless it is too small or may be cut off by the arc */
+static void close_segment(obstacle* obst) {
+	look_segment* s = &segment;
+
+	if (s->count >= SCAN_MIN_SAMPLES && !s->edge) {
+		float object[7];
+		uint16_t distance = s->range_sum / s->count;
+
+		object[ALL_ANGULAR_WIDTH] = s->end - s->start;
+		object[ALL_DISTANCE_SONAR] = distance;
+		object[ALL_DISTANCE_IR] = s->ir_sum / (10 * s->count);
+		object[ALL_LINEAR_WIDTH] = linear_width_cm(distance, s->end - s->start);
+		object[ALL_POSITION] = (s->start + s->end) / 2.0;
+		object[ALL_X] = s->x_sum / s->count;
+		object[ALL_Y] = s->y_sum / s->count;
+		associate_track(obst, object);
+	}
+	s->count = 0;
+}
+
+/* Takes the SONAR echo of the pending sample and adds the sample to the arc. Returns 1 if it is in the robot's path. */
+static char finish_sample(obstacle* obst, robot* bot) {
+	look_sample* p = &pending;
+	look_segment* s = &segment;
+	int range;
+	char hit = fuse_range(p->ir_mm / 10, scan_sonar_cm(read_PING_ticks()), &range) > 0 && range < MAX_DETECTION_DISTANCE;
+	char warn = 0;
+
+	if (s->count && (!hit || abs(range - s->last) > SCAN_EDGE_JUMP + s->last / 8)) // Nothing there, or a different object
+		close_segment(obst);
+
+	if (hit) {
+		pose_sample pose;
+		int16_t sine, cosine;
+		uint16_t bearing = GEO_DEGREES(p->angle);
+
+		pose_at(bot, p->time, &pose); // Where the robot was when the sample was taken, not where it is now
+		geo_project(&pose.x, &pose.y, range, GEO_DEGREES(pose.angle - 90) + bearing); // Same projection as find_objs_IR()
+
+		if (!s->count) {
+			s->start = p->angle;
+			s->range_sum = s->ir_sum = 0;
+			s->x_sum = s->y_sum = 0;
+			s->edge = 0;
+		}
+		s->count++;
+		s->end = p->angle;
+		s->last = range;
+		s->range_sum += range;
+		s->ir_sum += p->ir_mm;
+		s->x_sum += pose.x;
+		s->y_sum += pose.y;
+		if (p->angle <= LOOK_ARC_MIN || p->angle >= LOOK_ARC_MAX)
+			s->edge = 1;
+
+		geo_sincos(bearing, &sine, &cosine); // Servo 90 is straight ahead
+		warn = (long) range * sine < (long) LOOK_WARN_DISTANCE * GEO_ONE && labs((long) range * cosine) < (long) LOOK_CORRIDOR * GEO_ONE;
+	}
+
+	if (p->angle <= LOOK_ARC_MIN || p->angle >= LOOK_ARC_MAX) // The servo turns around here; the next samples come back the other way
+		close_segment(obst);
+
+	return warn;
+}
+
+char look_step(obstacle* obst, robot* bot) {
+	if (have_pending) {
+		if (finish_sample(obst, bot))
+			in_path++;
+		else
+			in_path = 0;
+	}
+
+	/* Start the sample at the current angle, tagged with the time it is taken */
+	pending.angle = servo;
+	send_pulse(); // Echo is read on the next call
+	pending.ir_mm = read_IR_distance_mm();
+	pending.time = uptime_ticks();
+	have_pending = 1;
+
+	/* Move on; the servo settles while the next sensor frame comes in */
+	if (servo + step > LOOK_ARC_MAX || servo + step < LOOK_ARC_MIN)
+		step = -step;
+	servo += step;
+	move_servo(&servo);
+
+	return in_path >= LOOK_WARN_HITS;
+}
+
+void look_end(obstacle* obst) {
+	have_pending = 0;
+	segment.count = 0; // Cut short by the stop, so part of it was never scanned
+	move_servo(&obst->degrees);
+	wait_ms(LOOK_SETTLE);
+}
@@ -0,0 +1,74 @@
+/*! \file lookahead.h
+    \brief Scanning a narrow forward arc while the robot drives.
+
+	While look-ahead is on, move() calls look_step() once per sensor frame. Each call finishes the
+	sample started on the previous call (its SONAR echo has had a frame to come back), reads the IR
+	and pings at the current servo angle, and steps the servo on, so the servo swings back and forth
+	between LOOK_ARC_MIN and LOOK_ARC_MAX.
+
+	Every sample is tagged with the time it was taken and projected into world coordinates from the
+	odometry pose interpolated to that time (see pose.h). Runs of samples at a steady range are handed to the tracker as
+	objects. Samples in the robot's path closer than LOOK_WARN_DISTANCE make look_step() warn, so the
+	robot can stop before the bumper hits.
+*/
+
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include <inttypes.h>
+#include "object_tracking.h"
+
+/*! \def LOOK_ARC_MIN
+	\brief Rightmost servo angle of the arc, in degrees
+*/
+#define LOOK_ARC_MIN 60
+/*! \def LOOK_ARC_MAX
+	\brief Leftmost servo angle of the arc, in degrees
+*/
+#define LOOK_ARC_MAX 120
+/*! \def LOOK_STEP
+	\brief Degrees the servo moves each sensor frame. Small enough for it to settle within one frame.
+*/
+#define LOOK_STEP 2
+/*! \def LOOK_WARN_DISTANCE
+	\brief Anything in the robot's path closer than this (in cm from the sensor) is a warning
+*/
+#define LOOK_WARN_DISTANCE 25
+/*! \def LOOK_CORRIDOR
+	\brief Half the width (in cm) of the path the robot sweeps, with some margin
+*/
+#define LOOK_CORRIDOR 20
+/*! \def LOOK_WARN_HITS
+	\brief Samples in a row that must be in the path before look_step() warns
+*/
+#define LOOK_WARN_HITS 2
+/*! \def LOOK_SETTLE
+	\brief Time in ms for the servo to get back from the arc to where sweep() left it
+*/
+#define LOOK_SETTLE 300
+
+/// Turns scanning while driving on or off.
+void look_enable(char on);
+
+/// Is scanning while driving on?
+char look_enabled(void);
+
+/// Points the servo at the start of the arc. Call before the wheels start.
+void look_begin(void);
+
+/// Takes one sample of the forward arc.
+/**
+* @param obst the tracker objects found in the arc are added to
+* @param bot the robot's current pose, kept up to date with pose_odometry()
+* @return 1 if something is in the robot's path within LOOK_WARN_DISTANCE
+*/
+char look_step(obstacle* obst, robot* bot);
+
+/// Puts the servo back where sweep() expects it. Call after the wheels stop.
+/**
+* An object the stop cut short is dropped, since part of it was never scanned.
+* @param obst its degrees is where the servo goes back to
+*/
+void look_end(obstacle* obst);
+
+#endif
@@ -11,11 +11,27 @@
 */
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include "object_tracking.h"
 #include "open_interface.h"
 #include "util.h"
 #include "lcd.h"
+#include "calibration.h"
+#include "geometry.h"
+#include "sram.h"
+#include "profile.h"
+#include "recorder.h"
+#include "surface.h"
+#include "script.h"
+#include "sequence.h"
+#include "lookahead.h"
+#include "pose.h"
+#include "explore.h"
+#include "idle.h"
+#include "energy.h"
 #include "main.h"
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 int main(void)
@@ -25,17 +41,30 @@ int main(void)
 	robot bot;
     oi_t *sensor_data = oi_alloc();
 	bot.initialized = 0; // Has to be called only once and before reset
+	calibration_load(); // Servo and IR sensor need calibration values before initializing
+	reset_object_array(&obst); // Start with no tracked objects
 	initalizations(&obst, &bot, &c);
+	rec_init(); // Needs the uptime clock started by initalizations
     oi_init(sensor_data);
+	script_init();
 	
 	while (1) {
-		oi_update(sensor_data);
+		do { // Keep watching the battery while the operator is quiet
+			oi_update(sensor_data);
+			pose_odometry(&bot, sensor_data); // Anything it coasted after the last command
+			
+			if (energy_state() == ENERGY_DOCK_DUE) { // Goes on taking commands while the Create finds the dock
+				send_message_P(PSTR("\r\nBattery low, returning to the dock\r\n"));
+				energy_dock();
+			}
+		} while (!USART_Wait(ENERGY_POLL_MS));
 		
 		//read_cliff_sensors(sensor_data);
 		
 		c.user_command = USART_Receive();
+		rec_log(REC_COMMAND, c.user_command, c.travel_dist, c.angle_to_turn);
 		
-		get_command(c, &obst, sensor_data, &bot);
+		get_command(&c, &obst, sensor_data, &bot);
 		
 		USART_Transmit(c.user_command);
 	}
@@ -43,142 +72,396 @@ int main(void)
 	return 0;
 }
 
-void move(oi_t *self, float distance_mm, obstacle* obst, robot* bot, control c) { // Find more accurate way of moving robot
-	float togo = distance_mm/0.11;                    // calculated sensor distance
+uint8_t move(oi_t *self, float distance_mm, obstacle* obst, robot* bot, control* c) { // Find more accurate way of moving robot
+	float togo = distance_mm * cal_store.odo_distance_scale / 256.0; // calculated sensor distance
 	float travel = 0;				                    // distance traveled by robot
-	bot->dist_traveled = distance_mm;
+	surface_event events[2 * SURFACE_CHANNELS];         // Cliff and tape crossings in one sensor frame
+	int16_t speed = energy_speed(150);                  // Cruise speed the battery allows
+	uint8_t stopped = 0;                                // Watchdog hazards nothing below logged
+	
+	oi_hazard_take(); // Forget hazards from before this move
 	
 	if (distance_mm > 0) {
-		oi_set_wheels(150, 150);
-		
-		while (travel < togo) { // [Bot 17]: White Tape -- CFL = 300, CFR = 300, L = 450 , R = 650; Red Tape -- CFL = >450, CFR = >800, L =  >600, R = >800
-			wait_ms(5);
-			if (((self->cliff_frontleft_signal > 740 && self->cliff_frontleft_signal < 850) || self->cliff_frontleft) || (self->cliff_frontright_signal > 350 && self->cliff_frontright_signal < 460) || self->cliff_frontright) {
-				if (self->cliff_frontleft || self->cliff_frontright)
-					log_position(obst, bot, MIDDLE, CLIFF, (distance_mm - travel)/10);
-				else
-					log_position(obst, bot, MIDDLE, WHITE, (distance_mm - travel)/10);
-				move(self, -distance_mm, obst, bot, c);
-				break;
-			} else if (self->cliff_frontleft_signal > 1100 || self->cliff_frontright_signal > 640) { // Red Tape Found
-				log_position(obst, bot, MIDDLE, RED, (distance_mm - travel)/10);
-				oi_load_song(c.s2_id, c.s2_num_notes, c.s2_notes, c.s2_duration);
-				oi_play_song(c.s2_id);
-			}
+		char looking = look_enabled();
+		char last_frame = 0; // Watchdog stopped the wheels; classify one more frame, then stop
+		if (looking)
+			look_begin();
+		
+		oi_set_wheels(speed, speed);
+		
+		while (travel < togo || last_frame) {
+			uint8_t hazards = oi_hazard_take(); // Watchdog may have stopped the wheels already
+			uint8_t before[SURFACE_CHANNELS]; // What each cliff sensor was over before this frame
+			for (int i = 0; i < SURFACE_CHANNELS; i++)
+				before[i] = surface_current(i);
 			
-			if ((self->cliff_left_signal > 450 && self->cliff_frontleft_signal < 560) || self->cliff_left) {
-				if (self->cliff_left)
-					log_position(obst, bot, LEFT, CLIFF, (distance_mm - travel)/10);
-				else
-					log_position(obst, bot, LEFT, WHITE, (distance_mm - travel)/10);
-				move(self, -distance_mm, obst, bot, c);
-				break;
-			} else if (self->cliff_left_signal > 780) { // Found Red Tape
-				log_position(obst, bot, LEFT, RED, (distance_mm - travel)/10);
-				oi_load_song(c.s2_id, c.s2_num_notes, c.s2_notes, c.s2_duration);
-				oi_play_song(c.s2_id);
+			uint8_t n = surface_update(self, events); // Once per sensor frame
+			char hazard = 0;
+			char middle_logged = 0;
+			
+			for (int i = 0; i < n; i++) {
+				if (!events[i].entered)
+					continue;
+				
+				if (events[i].side == MIDDLE) { // Both front sensors cross the same line; log it once
+					if (middle_logged || before[SURFACE_FRONT_LEFT + SURFACE_FRONT_RIGHT - events[i].channel] == events[i].surface)
+						continue;
+					middle_logged = 1;
+				}
+				
+				log_position(obst, bot, events[i].side, events[i].surface, 0); // The pose is already where the frame was taken
+				
+				if (events[i].surface == RED) { // Found Red Tape
+					explore_found_goal(bot->x, bot->y); // Even if there is no room to log it
+					oi_load_song(c->s2_id, c->s2_num_notes, c->s2_notes, c->s2_duration);
+					oi_play_song(c->s2_id);
+				} else { // Cliff or White Tape
+					hazard = 1;
+				}
 			}
 			
-			if ((self->cliff_right_signal > 480 && self->cliff_frontright_signal < 560) || self->cliff_right) {
-				if (self->cliff_right)
-					log_position(obst, bot, RIGHT, CLIFF, (distance_mm - travel)/10);
-				else
-					log_position(obst, bot, RIGHT, WHITE, (distance_mm - travel)/10);
-				move(self, -distance_mm, obst, bot, c);
+			if (hazard) {
+				stopped = move(self, -distance_mm, obst, bot, c);
 				break;
-			} else if (self->cliff_right_signal > 760) { // Found Red Tape
-				log_position(obst, bot, RIGHT, RED, (distance_mm - travel)/10);
-				oi_load_song(c.s2_id, c.s2_num_notes, c.s2_notes, c.s2_duration);
-				oi_play_song(c.s2_id);
 			}
 			
 			if (self->bumper_left && self->bumper_right) {
 				oi_set_wheels(0, 0);
-				log_position(obst, bot, MIDDLE, FLAT, (distance_mm - travel)/10); // divided by 10 to convert to cm
-				move(self, (distance_mm - travel)/10, obst, bot, c);
-				travel -= ((distance_mm - travel)/10)/0.115;
+				log_position(obst, bot, MIDDLE, FLAT, 0);
+				stopped = move(self, (distance_mm - travel)/10, obst, bot, c);
+				travel -= ((distance_mm - travel)/10) * cal_store.odo_distance_scale / 256.0;
 				wait_ms(100);
 				break;
 			} else if (self->bumper_left) {
 				oi_set_wheels(0, 0);
-				log_position(obst, bot, LEFT, FLAT, (distance_mm - travel)/10);
-				move(self, (distance_mm - travel)/10, obst, bot, c);
-				travel -= ((distance_mm - travel)/10)/0.115;
+				log_position(obst, bot, LEFT, FLAT, 0);
+				stopped = move(self, (distance_mm - travel)/10, obst, bot, c);
+				travel -= ((distance_mm - travel)/10) * cal_store.odo_distance_scale / 256.0;
 				wait_ms(100);
 				break;
 			} else if (self->bumper_right) {
 				oi_set_wheels(0, 0);
-				log_position(obst, bot, RIGHT, FLAT, (distance_mm - travel)/10);
-				move(self, (distance_mm - travel)/10, obst, bot, c);
-				travel -= ((distance_mm - travel)/10)/0.115;
+				log_position(obst, bot, RIGHT, FLAT, 0);
+				stopped = move(self, (distance_mm - travel)/10, obst, bot, c);
+				travel -= ((distance_mm - travel)/10) * cal_store.odo_distance_scale / 256.0;
 				wait_ms(100);
 				break;
 			}
+			
+			if (last_frame) // Watchdog stopped for something not handled above, like a wheel drop
+				break;
+			if (hazards) { // The watchdog may have seen it in a newer frame than this one; classify that frame first
+				last_frame = 1;
+				stopped = hazards;
+				oi_update(self);
+				pose_odometry(bot, self);
+				travel += self->distance;
+				continue;
+			}
+			
+			if (looking && look_step(obst, bot)) { // Something ahead; stop short of it
+				oi_set_wheels(0, 0);
+				break;
+			}
+			if (energy_state() == ENERGY_DOCK_DUE) { // Leave the charge that's left for finding the dock
+				oi_set_wheels(0, 0);
+				break;
+			}
+			
 			oi_update(self);
+			pose_odometry(bot, self);
 			travel += self->distance;
 		}
+		
+		if (looking) {
+			oi_set_wheels(0, 0);
+			look_end(obst);
+		}
 	} else if (distance_mm < 0) {
-		oi_set_wheels(-150, -150);
+		oi_set_wheels(-speed, -speed);
 		
-		while (travel > togo) {
+		while (travel > togo && !(stopped = oi_hazard_take())) {
 			oi_update(self);
+			pose_odometry(bot, self);
 			travel += self->distance;
 		}
 	}
 	
 	oi_set_wheels(0, 0);
+	return stopped;
 }
 
-void rotate(oi_t *self, float degrees, robot* bot) {
-		float sensordegrees = degrees/1.1; // calibration: make number smaller to oversteer.
+uint8_t rotate(oi_t *self, float degrees, robot* bot) {
+		float sensordegrees = degrees * cal_store.odo_angle_scale / 1024.0; // calibration: make number smaller to oversteer.
 		float toturn = 0;
+		uint8_t stopped = 0; // Hazards the watchdog stopped the turn for
 		
-		bot->angle += degrees;
-		
-		if (bot->angle < 0) {
-			bot->angle = 360 + bot->angle;
-			} else if (bot->angle > 360) {
-			bot->angle = bot->angle - 360;
-		}
+		oi_hazard_take(); // Forget hazards from before this turn
 		
 		if (degrees > 0){ //rotate CCW
 			oi_set_wheels(100,-100);
-			while (toturn < sensordegrees) {
+			while (toturn < sensordegrees && !(stopped = oi_hazard_take())) {
 				oi_update(self);
+				pose_odometry(bot, self);
 				toturn += self->angle;
 			}
 		}
 		if (degrees < 0){ //rotate CW
 			oi_set_wheels(-100,100);
-			while (toturn > sensordegrees) {
+			while (toturn > sensordegrees && !(stopped = oi_hazard_take())) {
 				oi_update(self);
+				pose_odometry(bot, self);
 				toturn += self->angle;
 			}
 		}
 		oi_set_wheels(0, 0); // stop
+		return stopped;
+}
+
+uint8_t watchdog_stop(robot* bot, uint8_t hazards) {
+	if (hazards) {
+		char buffer[50];
+		rec_log(REC_STOP, hazards, bot->x, bot->y);
+		rec_flush(); // Keep what led up to it
+		sprintf_P(buffer, PSTR("\r\nStopped by the watchdog, hazards %u\r\n"), hazards);
+		send_message(buffer);
+	}
+	return hazards;
+}
+
+void scripted_move(oi_t *self, float distance_cm, float degrees, robot* bot) {
+	oi_script s;
+	uint8_t status;
+	
+	if (energy_state() == ENERGY_DOCK_DUE) { // The Create won't listen once the script runs, so don't start one
+		send_message_P(PSTR("\r\nNot moving: the battery is due at the dock\r\n"));
+		return;
+	}
+	
+	script_begin(&s);
+	script_drive(&s, energy_speed(150), distance_cm * cal_store.odo_distance_scale / 256.0);
+	if (degrees != 0)
+		script_turn(&s, 100, degrees * cal_store.odo_angle_scale / 1024.0);
+	script_play(&s);
+	
+	do {
+		oi_update(self);
+		pose_odometry(bot, self);
+		status = script_poll(self);
+		
+		if (USART_Available()) { // The Create drives itself, so the operator can still get reports
+			unsigned char command = USART_Receive();
+			if (command == 'k') {
+				oi_link_report();
+			} else if (command == 'm') {
+				sram_report();
+			} else if (command == 't') {
+				prof_report();
+			} else if (command == 'u') {
+				idle_report();
+			} else if (command == 'B') {
+				energy_report();
+			}
+		}
+	} while (status == SCRIPT_RUNNING);
+	
+	if (status == SCRIPT_ABORTED) {
+		send_message_P(PSTR("\r\nScript stopped by the Create (cliff or wheel drop)\r\n"));
+	} else if (status == SCRIPT_TIMEOUT) {
+		send_message_P(PSTR("\r\nScript timed out\r\n"));
+	}
 }
 
-void get_command(control c, obstacle* obst, oi_t *self, robot* bot) {
-	if (c.user_command == 'w') {
-		move(self, c.travel_dist, obst, bot, c);
-	} else if (c.user_command == 'a') {
-		rotate(self, c.angle_to_turn, bot);
-	} else if (c.user_command == 'd') {
-		rotate(self, -c.angle_to_turn, bot);
-	} else if (c.user_command == 's') {
-		rotate(self, 180, bot);
-		move(self, c.travel_dist, obst, bot, c);
-	} else if (c.user_command == 'q') {
-		sweep(obst, bot);
+//! What a sequence step needs to drive the robot.
+typedef struct {
+	oi_t *self;
+	obstacle* obst;
+	robot* bot;
+	control* c;
+} sequence_context;
+
+/* Runs one step of an operator sequence. Stops the sequence when a hazard was logged, the dock is due, or the operator sends anything. */
+static char sequence_step(uint8_t step, int16_t argument, void* context) {
+	sequence_context* s = context;
+	uint8_t objects = s->obst->all_object_index;
+	
+	if (step == SEQ_MOVE) {
+		if (watchdog_stop(s->bot, move(s->self, argument, s->obst, s->bot, s->c)))
+			return 0;
+		if (s->obst->all_object_index != objects) // Ran into something; the rest was planned for a clear path
+			return 0;
+	} else if (step == SEQ_ROTATE) {
+		if (watchdog_stop(s->bot, rotate(s->self, argument, s->bot)))
+			return 0;
+	} else if (step == SEQ_SWEEP) {
+		sweep(s->obst, s->bot, SWEEP_BULK_PACKED);
+		initalizations(s->obst, s->bot, s->c);
+	} else if (step == SEQ_WAIT) {
+		wait_ms(argument);
+	}
+	
+	if (energy_state() == ENERGY_DOCK_DUE) { // The main loop sends it to the dock
+		send_message_P(PSTR("\r\nSequence stopped for the battery\r\n"));
+		return 0;
+	}
+	if (USART_Available()) { // Any key stops the sequence
+		USART_Receive();
+		return 0;
+	}
+	return 1;
+}
+
+void run_sequence(oi_t *self, obstacle* obst, robot* bot, control* c) {
+	char text[SEQ_MAX_TEXT + 1];
+	uint8_t length = 0;
+	unsigned char data;
+	uint8_t result = SEQ_NO_ROOM;
+	sequence_context context = {self, obst, bot, c};
+	
+	while ((data = USART_Receive()) != '}') {
+		if (length < SEQ_MAX_TEXT)
+			text[length] = data;
+		length++;
+	}
+	
+	if (length <= SEQ_MAX_TEXT) {
+		text[length] = 0;
+		result = seq_run(text, sequence_step, &context);
+	}
+	
+	if (result != SEQ_OK) {
+		char buffer[50];
+		sprintf_P(buffer, PSTR("\r\nSequence error %u at %u\r\n"), result, seq_error_at());
+		send_message(buffer);
+	}
+}
+
+void explore(oi_t *self, obstacle* obst, robot* bot, control* c) {
+	unsigned long start = uptime_ticks();
+	char buffer[60];
+	float x, y;
+	
+	explore_reset();
+	explore_mark_path(bot->x, bot->y, bot->x, bot->y); // Where it stands is clear
+	
+	while (1) {
+		if (explore_goal(&x, &y)) {
+			sprintf_P(buffer, PSTR("\r\nRetrieval zone found at (%.0f, %.0f)\r\n"), x, y);
+			send_message(buffer);
+			break;
+		}
+		if (uptime_ticks() - start > EXPLORE_BUDGET * 250000UL) { // 250000 ticks per second
+			send_message_P(PSTR("\r\nExploration out of time\r\n"));
+			break;
+		}
+		if (USART_Available()) { // Any key stops exploring
+			USART_Receive();
+			send_message_P(PSTR("\r\nExploration stopped\r\n"));
+			break;
+		}
+		if (energy_state() == ENERGY_DOCK_DUE) { // The main loop sends it to the dock
+			send_message_P(PSTR("\r\nExploration stopped for the battery\r\n"));
+			break;
+		}
+		
+		sweep(obst, bot, SWEEP_BULK_PACKED);
+		initalizations(obst, bot, c);
+		explore_mark_sweep(bot);
+		explore_mark_objects(obst);
+		update_information(obst, bot);
+		
+		if (!explore_frontier(bot, &x, &y)) {
+			send_message_P(PSTR("\r\nNothing left to explore\r\n"));
+			break;
+		}
+		
+		/* Head for the frontier, one leg at a time */
+		float dx = x - bot->x, dy = y - bot->y;
+		float distance = sqrt(dx * dx + dy * dy);
+		float turn = atan2(dy, dx) * 180 / M_PI - bot->angle;
+		if (turn > 180)
+			turn -= 360;
+		else if (turn < -180)
+			turn += 360;
+		if (fabs(turn) > 5 && watchdog_stop(bot, rotate(self, turn, bot)))
+			break;
+		
+		float leg = (distance < EXPLORE_STEP) ? distance : EXPLORE_STEP;
+		float x0 = bot->x, y0 = bot->y;
+		uint8_t stopped = move(self, leg, obst, bot, c);
+		explore_mark_path(x0, y0, bot->x, bot->y);
+		if (watchdog_stop(bot, stopped))
+			break;
+		
+		dx = bot->x - x0;
+		dy = bot->y - y0;
+		if (dx * dx + dy * dy < leg * leg / 4) // Stopped well short; don't keep trying the same way
+			explore_give_up(x, y);
+	}
+	
+	explore_mark_objects(obst); // Hazards from the last leg
+	explore_send_map(bot);
+}
+
+void get_command(control* c, obstacle* obst, oi_t *self, robot* bot) {
+	if ((energy_state() == ENERGY_DOCKING || energy_state() == ENERGY_DOCKED) && strchr_P(PSTR("wads{ex"), c->user_command)) { // Driving takes it back
+		energy_cancel_dock();
+		send_message_P(PSTR("\r\nDocking cancelled\r\n"));
+	}
+	
+	if (c->user_command == 'w') {
+		watchdog_stop(bot, move(self, c->travel_dist, obst, bot, c));
+	} else if (c->user_command == 'a') {
+		watchdog_stop(bot, rotate(self, c->angle_to_turn, bot));
+	} else if (c->user_command == 'd') {
+		watchdog_stop(bot, rotate(self, -c->angle_to_turn, bot));
+	} else if (c->user_command == 's') {
+		if (!watchdog_stop(bot, rotate(self, 180, bot))) // Don't drive off in whatever direction an aborted turn left it facing
+			watchdog_stop(bot, move(self, c->travel_dist, obst, bot, c));
+	} else if (c->user_command == '{') {
+		run_sequence(self, obst, bot, c);
+	} else if (c->user_command == 'e') {
+		explore(self, obst, bot, c);
+	} else if (c->user_command == 'v') {
+		look_enable(!look_enabled());
+		send_message_P(look_enabled() ? PSTR("\r\nLook-ahead on\r\n") : PSTR("\r\nLook-ahead off\r\n"));
+	} else if (c->user_command == 'x') {
+		scripted_move(self, c->travel_dist, c->angle_to_turn, bot);
+	} else if (c->user_command == 'q') {
+		sweep(obst, bot, SWEEP_ROWS);
 		// print_and_process_stats(obst);
-		initalizations(obst, bot, &c);
-	} else if (c.user_command == 'r') {
+		initalizations(obst, bot, c);
+	} else if (c->user_command == 'g') {
+		sweep(obst, bot, SWEEP_BULK_PACKED);
+		initalizations(obst, bot, c);
+	} else if (c->user_command == 'G') {
+		sweep(obst, bot, SWEEP_BULK);
+		initalizations(obst, bot, c);
+	} else if (c->user_command == 'r') {
 		reset_object_array(obst);
-	} else if (c.user_command == 'b') {
+	} else if (c->user_command == 'b') {
 		reinitialize_bot(bot);
-	} else if (c.user_command == '1') {
-		oi_load_song(c.s1_id, c.s1_num_notes, c.s1_notes, c.s1_duration);
-		oi_play_song(c.s1_id);
+	} else if (c->user_command == 'p') {
+		request_full_report(obst, bot);
+	} else if (c->user_command == 'c') {
+		calibration_menu(self);
+	} else if (c->user_command == 'm') {
+		sram_report();
+	} else if (c->user_command == 't') {
+		prof_report();
+	} else if (c->user_command == 'u') {
+		idle_report();
+	} else if (c->user_command == 'B') {
+		energy_report();
+	} else if (c->user_command == 'k') {
+		oi_link_report();
+	} else if (c->user_command == 'f') {
+		rec_flush();
+	} else if (c->user_command == 'l') {
+		rec_download();
+	} else if (c->user_command == '1') {
+		oi_load_song(c->s1_id, c->s1_num_notes, c->s1_notes, c->s1_duration);
+		oi_play_song(c->s1_id);
 	}
 	update_information(obst, bot);
 }
@@ -190,58 +473,24 @@ void read_cliff_sensors(oi_t *self) {
 }
 
 void log_position(obstacle* obst, robot* bot, char bumper_cliff, char object, signed char dist) {
+	rec_log(REC_HAZARD, (bumper_cliff << 4) | ((object - CLIFF) / 5), bot->x, bot->y);
+	rec_flush(); // Keep what led up to the hazard
+	
+	if (obst->all_object_index >= MAX_OBJECTS) // No room left to track it
+		return;
+	
 	dist *= -1; // When backing up, we need to pass in the distance we backed up.
-	if (bumper_cliff == LEFT) {
-		if (object == CLIFF) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = CLIFF;
-		} else if (object == WHITE) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = WHITE;
-		} else if(object == RED) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = RED;
-		} else {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = FLAT;
-		}
-		
-	} else if (bumper_cliff == MIDDLE) {
-		if (object == CLIFF) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = CLIFF;
-		} else if (object == WHITE) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = WHITE;
-		} else if (object == RED) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = RED;
-		} else {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = FLAT;
-		}
-	} else if (bumper_cliff == RIGHT) {
-		if (object == CLIFF) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = CLIFF;
-		} else if(object == WHITE) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = WHITE;
-		} else if(object == RED) {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = RED;
-		} else {
-			log_position_helper(obst, bot, dist);
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = FLAT;
-		}
-	}
+	log_position_helper(obst, bot, dist);
 	
-	obst->all_object_index++;
-	bot->dist_traveled = dist;
+	add_track(obst, TRACK_CONFIDENCE_MAX, (object == CLIFF || object == WHITE || object == RED) ? object : FLAT); // A sweep can't see hazards, so they are never dropped
 }
 
 void log_position_helper(obstacle* obst, robot* bot, signed char dist) {
+	for (int j = 0; j < 7; j++) // Hazards have no width or sweep angle
+		obst->all_objects_array[obst->all_object_index][j] = 0;
 	obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] = dist; // Obvious
-	obst->all_objects_array[obst->all_object_index][ALL_X] = (bot->x + dist * (cos((bot->angle + 45) * (3.141516/180)))) + (12 + dist) * (cos(bot->angle + 45) * (3.141516/180)); // distance value is 12 (+ 15 to account for when the bot backs up)
-	obst->all_objects_array[obst->all_object_index][ALL_Y] = (bot->y + dist * (sin((bot->angle + 45) * (3.141516/180)))) + (12 + dist) * (sin(bot->angle + 45) * (3.141516/180)); // distance value is 12 (+ 15 to account for when the bot backs up)
+	float x = bot->x, y = bot->y;
+	geo_project(&x, &y, dist + (12 + dist), GEO_DEGREES(bot->angle + 45)); // distance value is 12 (+ 15 to account for when the bot backs up)
+	obst->all_objects_array[obst->all_object_index][ALL_X] = x;
+	obst->all_objects_array[obst->all_object_index][ALL_Y] = y;
 }
\ No newline at end of file
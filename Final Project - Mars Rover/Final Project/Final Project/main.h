@@ -12,13 +12,16 @@
 /// Moves the robot a specified distance. Written by Dalton and improved upon by Omar and Louis.
 /**
 * A recursive function that utilizes the oi_set_wheels function of open interface to move the object a certain distance.
+* With look-ahead on (see lookahead.h) the servo scans the forward arc while driving forward, and the robot stops short of anything in its path.
+* Driving forward also stops when the battery comes due at the dock (see energy.h).
 * @param self a structure storing the iRobot Create's sensor data.
 * @param distance_mm the distance the iRobot Create will travel in centimeters (to be converted to mm).
 * @param obst a structure storing relevant information related to object detection and tracking.
 * @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
 * @param c a structure storing relevant information related to manual operation of the robot. In this function, it allows the robot to play a specified song when it reaches the retrival zone.
+* @return OI_HAZARD_ bits the hazard watchdog stopped the robot for that weren't logged and backed away from, such as a wheel drop or anything while reversing; 0 otherwise
 */
-void move(oi_t *self, float distance_mm, obstacle* obst, robot* bot, control c);
+uint8_t move(oi_t *self, float distance_mm, obstacle* obst, robot* bot, control* c);
 
 /// Rotates the robot a specified angle. Written by Dalton.
 /**
@@ -26,18 +29,62 @@ void move(oi_t *self, float distance_mm, obstacle* obst, robot* bot, control c);
 * @param self a structure storing the iRobot Create's sensor data.
 * @param degrees the angle the iRobot Create will rotate in degrees. Positive degrees is counter-clockwise and negative degrees is clockwise.
 * @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
+* @return OI_HAZARD_ bits if the hazard watchdog stopped the turn short, 0 if it finished
 */
-void rotate(oi_t *self, float degrees, robot *bot);
+uint8_t rotate(oi_t *self, float degrees, robot *bot);
+
+/// Logs a stop by the hazard watchdog that move() or rotate() returned.
+/**
+* Records a REC_STOP event, flushes the recorder, and tells the operator. Callers stop what they were doing when it returns nonzero.
+* @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
+* @param hazards what move() or rotate() returned
+* @return hazards
+*/
+uint8_t watchdog_stop(robot* bot, uint8_t hazards);
+
+/// Moves and then turns the robot with a script the Create runs on its own.
+/**
+* The Create ends the drive and the turn on its own odometry, so the loop here only watches the sensor frames and answers the operator's 'k', 'm', 't', 'u', and 'B' reports meanwhile.
+* The pose is updated from what the Create actually reported, including when it stopped the script early.
+* Doesn't start when the battery is due at the dock, since the script can't be stopped once it runs.
+* @param self a structure storing the iRobot Create's sensor data.
+* @param distance_cm the distance to drive in centimeters. Negative drives backwards.
+* @param degrees the angle to turn afterwards. Positive degrees is counter-clockwise.
+* @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
+*/
+void scripted_move(oi_t *self, float distance_cm, float degrees, robot* bot);
+
+/// Reads an operator sequence up to '}' and runs it.
+/**
+* See sequence.h for the steps. Moves, turns, and sweeps run back to back with no report in between; get_command() reports once when the sequence is done.
+* The sequence stops early when a move runs into a hazard or the operator sends any character. Errors are sent as "Sequence error <code> at <offset>".
+* @param self a structure storing the iRobot Create's sensor data.
+* @param obst a structure storing relevant information related to object detection and tracking.
+* @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
+* @param c a structure storing relevant information related to manual operation of the robot.
+*/
+void run_sequence(oi_t *self, obstacle* obst, robot* bot, control* c);
+
+/// Explores the field on its own until the retrieval zone is found.
+/**
+* Sweeps, adds the sweep and the logged objects and hazards to the exploration map (see explore.h), then turns towards the nearest frontier and drives up to EXPLORE_STEP cm towards it, and repeats.
+* Stops when red tape has been logged, no frontier is left, EXPLORE_BUDGET seconds have passed, the battery is down to the dock reserve, or the operator sends any character, and then sends the map.
+* @param self a structure storing the iRobot Create's sensor data.
+* @param obst a structure storing relevant information related to object detection and tracking.
+* @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing.
+* @param c a structure storing relevant information related to manual operation of the robot.
+*/
+void explore(oi_t *self, obstacle* obst, robot* bot, control* c);
 
 /// Receives a command from the operator. Written by Omar.
 /**
-* A function that waits for a command from the operator and performs the corresponding action ('w' to move forward, 'a' to rotate left, 'd' to rotate right, 's' to indirectly move backwards, 'q' to scan, 'r' to reset tracked objects, 'b' to re-initialize the robot's Cartesian coordinates and angle, and '1' to play a song.
+* A function that waits for a command from the operator and performs the corresponding action ('w' to move forward, 'a' to rotate left, 'd' to rotate right, 's' to indirectly move backwards, 'x' to move and turn with a Create script, '{' to run a command sequence up to '}', 'v' to turn scanning while driving on or off, 'e' to explore on its own, 'q' to scan, 'g' to scan and send the sweep as one compressed frame ('G' for a raw frame), 'r' to reset tracked objects, 'b' to re-initialize the robot's Cartesian coordinates and angle, 'c' to calibrate, 'p' to resend every tracked object, 'm' to report SRAM usage, 'k' to report Create link statistics, 't' to report and clear profiler timings, 'u' to report how busy the CPU has been since the last 'u', 'B' to report the battery and energy budget, 'f' to save the flight recorder to EEPROM, 'l' to download the flight recorder, and '1' to play a song. Only what changed is reported after each command. A drive command while the Create is docking (see energy.h) takes it back from the dock first.
 * @param c a structure storing relevant information related to manual operation of the robot. In this function, it allows the robot to operate based on input given by the operator via bluetooth communication.
 * @param obst a structure storing relevant information related to object detection and tracking. Needs to be passed in to be used by other functions called within.
 * @param self a structure storing the iRobot Create's sensor data. Needs to be passed in to be used by other functions called within.
 * @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing. Needs to be passed in to be used by other functions called within.
 */
-void get_command(control c, obstacle* obst, oi_t *self, robot* bot);
+void get_command(control* c, obstacle* obst, oi_t *self, robot* bot);
 
 /// Reads data from the robot's cliff sensors. Written by Omar.
 /**
@@ -53,7 +100,7 @@ void read_cliff_sensors(oi_t *self);
 * @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing. In this function, it is needed for calculation.
 * @param bumper_cliff the side of the robot the object was detected on by the bumper or cliff sensors
 * @param object the type of object that was detected
-* @param dist the distance the robot traveled in total. Necessary for performing accurate calculations.
+* @param dist how far (in cm) the robot has moved on since the hazard was detected. 0 when the pose is already where the hazard was detected, as it is in move().
 */
 void log_position(obstacle* obst, robot* bot, char bumper_cliff, char object, signed char dist);
 
@@ -62,6 +109,6 @@ void log_position(obstacle* obst, robot* bot, char bumper_cliff, char object, si
 * This method performs the calculations and initial position assignments for log_position to reduce code redundancy.
 * @param obst a structure storing relevant information related to object detection and tracking. In this function, it is needed to assign information found.
 * @param bot a structure keeping track of the robot's Cartesian coordinates and direction the robot is facing. In this function, it is needed for calculation.
-* @param dist the distance the robot traveled in total. Necessary for performing accurate calculations.
+* @param dist how far (in cm) the robot has moved on since the hazard was detected.
 */
 void log_position_helper(obstacle* obst, robot* bot, signed char dist);
\ No newline at end of file
@@ -7,13 +7,21 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdio.h>
 #include <math.h>
 #include "lcd.h"
 #include "util.h"
+#include "sensor_fusion.h"
+#include "scan.h"
+#include "geometry.h"
+#include "profile.h"
+#include "recorder.h"
+#include "pose.h"
+#include "energy.h"
 #include "object_tracking.h"
 
-void initializations(obstacle* obst, robot* bot, control* c) {
+void initalizations(obstacle* obst, robot* bot, control* c) {
 	obst->degrees = 0.0; // Start angle at 0
 	
 	lcd_init();               // Initialize LCD
@@ -24,19 +32,11 @@ void initializations(obstacle* obst, robot* bot, control* c) {
 	move_servo(&obst->degrees);     // Move Servo to starting position
 	wait_ms(500);             // Wait for Servo to settle
 	
-	/* IR Variable Initializations */
+	/* Sensor Variable Initializations */
 	obst->cur_dist_IR = 0.0;
-	obst->last_dist_IR = 0.0;
-	obst->total_dist_IR = 0.0;
-	obst->start_angle_IR = 0.0;
-	obst->end_angle_IR = 0.0;
-	obst->object_detected = 0.0; // Using ^= to toggle breaks program if used a lot. Why?
-	
-	/* SONAR Variable Initializations */
 	obst->cur_dist_SONAR = 0.0;
-	obst->last_dist_SONAR = 0.0;
-	obst->start_dist_SONAR = 0.0;
-	obst->end_dist_SONAR = 0.0;
+	obst->cur_dist_fused = 0;
+	obst->cur_confidence = 0;
 	
 	/* Smallest Object Variable Initializations */
 	obst->smallest_obj_angular_size = 50.0;
@@ -52,16 +52,14 @@ void initializations(obstacle* obst, robot* bot, control* c) {
 	obst->closest_obj_dist_IR = 2752.0;   // Approximate IR Range Limit
 	obst->closest_obj_position = 0.0;
 	
-	/* Object Validation Level Initialization */
-	obst->validation_level = 0.0;
-	
 	/* Robot Coordinates Initialization */
 	if (bot->initialized == 0) {
 		bot->x = 0.0;
 		bot->y = 0.0;
 		bot->angle = 90.0;
-		bot->dist_traveled = 0.0;
 		bot->initialized ^= 1;
+		bot->pose_changed = 1;
+		pose_reset(bot);
 	}
 	
 	/* Main Initializations */
@@ -85,34 +83,56 @@ void initializations(obstacle* obst, robot* bot, control* c) {
 	// Note: Object array does not need to be initialized
 }
 
-void sweep(obstacle* obst, robot* bot) {
+void sweep(obstacle* obst, robot* bot, char bulk) {
 	/* Clear PuTTY view and initialize columns */
-	send_message("\f");
-	send_message("Degrees       IR Distance (cm)    Sonar Distance (cm)\r\n");
+	if (!bulk) {
+		send_message_P(PSTR("\f"));
+		send_message_P(PSTR("Degrees       IR Distance (cm)    Sonar Distance (cm)\r\n"));
+	}
 	
 	/* Data to be Sent to Putty */
 	char buffer[53];
+	int fused_dist;
+	uint8_t step = energy_scan_step(); // Degrees between samples the battery allows
 	
-	/* Perform 180 degree scan. Collect distance measurements every 1 degree. */
-	for (char i = 0; i <= 180; i++) {
-		send_pulse();                                // Ping the SONAR sensor
-		obst->cur_dist_IR = read_IR_distance();      // Get current IR distance measurement
-		obst->cur_dist_SONAR = read_PING_distance(); // Get current SONAR distance measurement
-		
-		/* Prepare buffer for transmission */
-		sprintf(buffer, "%-3d             %-4d                 %-3.4f\r\n", i, obst->cur_dist_IR, obst->cur_dist_SONAR);
-		
-		/* Send data to putty */
-		send_message(buffer);
+	/* Perform 180 degree scan. Collect distance measurements every step degrees and hold them in between. */
+	for (int i = 0; i < SCAN_SAMPLES; i++) {
+		if (i % step == 0) {
+			send_pulse();                                 // Ping the SONAR sensor
+			uint16_t ir_cm = read_IR_distance_mm() / 10;  // Get current IR distance measurement
+			scan_data[i].ir_cm = (ir_cm > SCAN_IR_MAX) ? SCAN_IR_MAX : ir_cm;
+			scan_data[i].sonar_ticks = read_PING_ticks(); // Get current SONAR distance measurement
+		} else {
+			scan_data[i] = scan_data[i - 1];
+		}
 		
-		/* Find Objects IR */
-		find_objs_IR(obst, bot);
+		if (!bulk) { // Report this degree now
+			obst->cur_dist_IR = scan_data[i].ir_cm;
+			obst->cur_dist_SONAR = read_PING_distance();
+			obst->cur_confidence = fuse_range(obst->cur_dist_IR, obst->cur_dist_SONAR, &fused_dist); // Combine them
+			obst->cur_dist_fused = fused_dist;
+			
+			/* Prepare buffer for transmission */
+			sprintf_P(buffer, PSTR("%-3d             %-4d                 %-3.4f\r\n"), i, obst->cur_dist_IR, obst->cur_dist_SONAR);
+			
+			/* Send data to putty */
+			send_message(buffer);
+		}
 		
 		obst->degrees++;            // Increment degree by 1
-		move_servo(&obst->degrees); // Move servo into next position
-		wait_ms(10);          // Wait for servo to position itself
+		if ((i + 1) % step == 0) {  // Next sample is taken there
+			move_servo(&obst->degrees); // Move servo into next position
+			wait_ms(10);          // Wait for servo to position itself
+		}
 	}
 	
+	/* Send the whole sweep at once */
+	if (bulk)
+		scan_send_bulk(bulk == SWEEP_BULK_PACKED ? SCAN_FRAME_PACKED : (bulk == SWEEP_BULK_DELTA ? SCAN_FRAME_DELTA : 0));
+	
+	/* Find Objects in the completed sweep */
+	find_objs_IR(obst, bot);
+	
 	/* Find Smallest Object */
 	find_smallest_obj(obst);
 	
@@ -121,74 +141,109 @@ void sweep(obstacle* obst, robot* bot) {
 }
 
 char get_linear_width(obstacle* obst) {
-	return 2 * obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] * tan((obst->all_objects_array[obst->all_object_index][ALL_ANGULAR_WIDTH] * (3.141516/180)) / 2); // sin((3.141516/180) * obst->object_array[obst->object_index][ANGULAR_WIDTH]) * obst->object_array[obst->object_index][DISTANCE_SONAR];
+	return linear_width_cm(obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR], obst->all_objects_array[obst->all_object_index][ALL_ANGULAR_WIDTH]); // 2 * distance * tan(angular width / 2)
 }
 
 void update_information(obstacle* obst, robot* bot) {
-	char buffer[500];
-	bot->x += bot->dist_traveled * cos(bot->angle * (3.141516/180)); // Update robot x coordinate
-	bot->y += bot->dist_traveled * sin(bot->angle * (3.141516/180)); // Update robot y coordinate
+	char buffer[100]; // One line at a time
+	
+	PROF_BEGIN(PROF_UPDATE_INFO);
+	
+	if (obst->resync_due) { // Lost track of what was removed. Start the operator's table over.
+		request_full_report(obst, bot);
+		obst->removed_count = 0;
+		obst->resync_due = 0;
+	}
+	for (int i = 0; i < obst->removed_count; i++) { // Tell the operator which objects are gone
+		sprintf_P(buffer, PSTR("\r\nObject %d Removed"), obst->removed_ids[i]);
+		send_message(buffer);
+	}
+	obst->removed_count = 0;
 	
 	if (obst->all_object_index > 0) { // Are there objects to keep track of? If so, update the objects distance and angle in respect to the robot
 		for (int i = 0; i < obst->all_object_index; i++) { // Loop through total detected objects
-			obst->all_objects_array[i][ALL_DISTANCE_SONAR] = sqrt( pow(bot->x - obst->all_objects_array[i][ALL_X], 2) + pow(bot->y - obst->all_objects_array[i][ALL_Y], 2) ); // Apply distance formula
+			char changed = (obst->changed_objects & (1UL << i)) != 0;
 			
-			if (obst->all_objects_array[i][ALL_X] - bot->x < 0 || (obst->all_objects_array[i][ALL_X] - bot->x < 0 && obst->all_objects_array[i][ALL_Y] - bot->y < 0) ) { // Quadrant II or Quadrant III: Add 180
-				obst->all_objects_array[i][ALL_POSITION] = atan( ((obst->all_objects_array[i][ALL_Y] - bot->y) / (obst->all_objects_array[i][ALL_X] - bot->x))) * (180/3.141516) + 180; // Apply formula (arctan ( y / x )) to find theta
-				} else if ((obst->all_objects_array[i][ALL_Y] - bot->y) < 0 && obst->all_objects_array[i][ALL_X] - bot->x > 0) {                                      // Quadrant IV: Add 360
-				obst->all_objects_array[i][ALL_POSITION] = atan( ((obst->all_objects_array[i][ALL_Y] - bot->y) / (obst->all_objects_array[i][ALL_X] - bot->x))) * (180/3.141516) + 360; // Apply formula (arctan ( y / x )) to find theta
-				} else {                            // Quadrant I: Use calculator
-				obst->all_objects_array[i][ALL_POSITION] = atan( ((obst->all_objects_array[i][ALL_Y] - bot->y) / (obst->all_objects_array[i][ALL_X] - bot->x))) * (180/3.141516);       // Apply formula (arctan ( y / x )) to find theta
-			}
-			if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] == CLIFF) {
-				sprintf(buffer, "\r\nCliff %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+			if (!changed && !bot->pose_changed) // Neither the object nor the robot moved
+				continue;
+			
+			int16_t dx = obst->all_objects_array[i][ALL_X] - bot->x;
+			int16_t dy = obst->all_objects_array[i][ALL_Y] - bot->y;
+			obst->all_objects_array[i][ALL_DISTANCE_SONAR] = geo_hypot(dx, dy); // Apply distance formula
+			obst->all_objects_array[i][ALL_POSITION] = geo_atan2(dy, dx) * (360.0/65536); // Angle from the x axis, 0 to 360 degrees
+			
+			if (!changed) // Operator already has its coordinates
+				continue;
+			
+			if (obst->object_kind[i] == CLIFF) {
+				sprintf_P(buffer, PSTR("\r\nCliff %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nCliff %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nCliff %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
-			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] == WHITE) {
-				sprintf(buffer, "\r\nWhite Tape %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+			} else if (obst->object_kind[i] == WHITE) {
+				sprintf_P(buffer, PSTR("\r\nWhite Tape %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nWhite Tape %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nWhite Tape %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
-			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] == RED) {
-				sprintf(buffer, "\r\nRed Tape %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+			} else if (obst->object_kind[i] == RED) {
+				sprintf_P(buffer, PSTR("\r\nRed Tape %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nRed Tape %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nRed Tape %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
-			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] == FLAT) {
-				sprintf(buffer, "\r\nFlat Object %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+			} else if (obst->object_kind[i] == FLAT) {
+				sprintf_P(buffer, PSTR("\r\nFlat Object %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nFlat Object %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nFlat Object %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
-			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] < 100 && obst->all_objects_array[i][ALL_LINEAR_WIDTH] > SMALL_OBJECT_SIZE_MAX) {
-				sprintf(buffer, "\r\nObstacle %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] > SMALL_OBJECT_SIZE_MAX) {
+				sprintf_P(buffer, PSTR("\r\nObstacle %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nObstacle %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nObstacle %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
 			} else if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] < SMALL_OBJECT_SIZE_MAX) {
-				sprintf(buffer, "\r\nGoal Post %d Coordinates: (%lf, %lf)\r\n", i, obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
+				sprintf_P(buffer, PSTR("\r\nGoal Post %d Coordinates: (%lf, %lf)\r\n"), obst->object_id[i], obst->all_objects_array[i][ALL_X], obst->all_objects_array[i][ALL_Y]);
 				send_message(buffer);
-				sprintf(buffer, "\r\nGoal Post %d Distance: %lf | Position %lf", i, obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
+				sprintf_P(buffer, PSTR("\r\nGoal Post %d Distance: %lf | Position %lf"), obst->object_id[i], obst->all_objects_array[i][ALL_DISTANCE_SONAR], obst->all_objects_array[i][ALL_POSITION]);
 				send_message(buffer);
 			}
 			
 		}
 	}
 	
-	sprintf(buffer, "\r\nBot X: %.3lf\r\nBot Y: %.3lf\r\nBot Angle: %.3lf\r\n", bot->x, bot->y, bot->angle);
-	send_message(buffer);
+	obst->changed_objects = 0;
 	
-	// Do not reset the angle. Bot needs to know where it was last angled to be accurate.
-	bot->dist_traveled = 0; // Reset for next run
+	if (bot->pose_changed) {
+		sprintf_P(buffer, PSTR("\r\nBot X: %.3lf\r\nBot Y: %.3lf\r\nBot Angle: %.3lf\r\n"), bot->x, bot->y, bot->angle);
+		send_message(buffer);
+		bot->pose_changed = 0;
+	}
+	
+	PROF_END(PROF_UPDATE_INFO);
+}
+
+void request_full_report(obstacle* obst, robot* bot) {
+	obst->changed_objects = (obst->all_object_index < 32) ? (1UL << obst->all_object_index) - 1 : ~0UL;
+	bot->pose_changed = 1;
+	
+	char buffer[30];
+	sprintf_P(buffer, PSTR("\r\nTracking %d objects\r\n"), obst->all_object_index);
+	send_message(buffer);
 }
 
 void reset_object_array(obstacle* obst) {
 	obst->all_object_index = 0.0;
+	obst->next_object_id = 0;
+	obst->changed_objects = 0;
+	obst->removed_count = 0;
+	obst->resync_due = 0;
 	
-	for (int i = 0; i < 15; i++) { // reset object arrays
+	for (int i = 0; i < MAX_OBJECTS; i++) { // reset object arrays
 		for (int j = 0; j < 7; j++) {
 			obst->all_objects_array[i][j] = 0;
 		}
+		obst->object_id[i] = 0;
+		obst->object_confidence[i] = 0;
+		obst->object_kind[i] = 0;
 	}
 }
 
@@ -196,59 +251,47 @@ void reinitialize_bot(robot* bot) {
 	bot->x = 0.0;
 	bot->y = 0.0;
 	bot->angle = 90.0;
-	bot->dist_traveled = 0.0;
+	bot->pose_changed = 1;
+	pose_reset(bot); // The old history is in the old coordinates
 }
 
 void find_objs_IR(obstacle* obst, robot* bot) {
-	if (obst->cur_dist_IR <= MAX_DETECTION_DISTANCE) { // Current IR measured distance is within detection range?
-		if (obst->object_detected == 0) { // If yes, are we looking for a new object?
-			obst->object_detected = 1; // We've detected something
-			obst->start_angle_IR = obst->degrees; // Log start angle
-			obst->start_dist_SONAR = obst->cur_dist_SONAR; // Log distance measured by sonar as start distance (IR is less consistent, but computed averages anyway as backup)
-			obst->validation_level++; // Begin object validation sequence
-		} else if (obst->object_detected == 1) { // Continue object validation sequence if still in detection range
-			obst->validation_level++;
-			obst->total_dist_IR += obst->cur_dist_IR; // Find total distance measured by IR
-		}
-		} else {
-		if ((obst->object_detected == 1 && obst->validation_level >= SMALL_OBJECT_SIZE_MIN)) { // We've finished seeing the object. Is the object valid (at least as big as smallest object size)?
-			obst->end_angle_IR = obst->degrees - 1; // Log the last measured angle
-			obst->end_dist_SONAR = obst->last_dist_SONAR; // Log the last distance measured by the sonar as end distance (same reason as before)
-			obst->object_detected = 0; // Reset detection variable
-			obst->all_objects_array[obst->all_object_index][ALL_ANGULAR_WIDTH] = obst->end_angle_IR - obst->start_angle_IR; // Log calculated object angular size
-			obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] = (obst->start_dist_SONAR + obst->end_dist_SONAR) / 2; // Log calculated object distance
-			obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_IR] = obst->total_dist_IR / (obst->validation_level - 1); // IR Distance = Average = Sum/N (total distance/number of distance measurements), where validation level serves as N - 1 (to account for extra sample at line 113)
-			obst->all_objects_array[obst->all_object_index][ALL_LINEAR_WIDTH] = get_linear_width(obst); // Log calculated linear width
-			obst->all_objects_array[obst->all_object_index][ALL_POSITION] = (obst->start_angle_IR + (obst->all_objects_array[obst->all_object_index][ALL_ANGULAR_WIDTH] / 2)); // Log calculated object angular position
-			if (bot->angle - 90 + obst->all_objects_array[obst->all_object_index][ALL_POSITION] > 360) { // Account for overflow
-				obst->all_objects_array[obst->all_object_index][ALL_X] = bot->x + obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] * cos((bot->angle - 90 + obst->all_objects_array[obst->all_object_index][ALL_POSITION] - 360) * (3.141516/180));
-				obst->all_objects_array[obst->all_object_index][ALL_Y] = bot->y + obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] * sin((bot->angle - 90 + obst->all_objects_array[obst->all_object_index][ALL_POSITION]) * (3.141516/180));
-			} else {
-				obst->all_objects_array[obst->all_object_index][ALL_X] = bot->x + obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] * cos((bot->angle - 90 + obst->all_objects_array[obst->all_object_index][ALL_POSITION]) * (3.141516/180)); // Assign X coordinate of object in respect to the bot
-				obst->all_objects_array[obst->all_object_index][ALL_Y] = bot->y + obst->all_objects_array[obst->all_object_index][ALL_DISTANCE_SONAR] * sin((bot->angle - 90 + obst->all_objects_array[obst->all_object_index][ALL_POSITION]) * (3.141516/180)); // Assign Y coordinate of object in respect to the bot	
-			}
-			obst->all_object_index++; // Move to next index
-			
-			if (obst->all_object_index > 1)
-				find_dupilicate(obst, bot);
-			
-			obst->validation_level = 0; // Reset validation level
-		}
-		else if (obst->object_detected == 1) { // Object is an anomaly. Reset last logged variables.
-			obst->validation_level = 0;
-			obst->start_angle_IR = 0;
-			obst->start_dist_SONAR = 0;
-			obst->object_detected = 0;
-			obst->total_dist_IR = 0;
-		}
+	PROF_BEGIN(PROF_FIND_OBJS);
+	
+	scan_segment segments[SCAN_MAX_SEGMENTS];
+	char found = scan_segment_objects(segments, SCAN_MAX_SEGMENTS); // Split the sweep into objects
+	unsigned long seen = 0; // Tracked objects seen in this sweep
+	
+	for (int i = 0; i < found; i++) {
+		float object[7]; // Laid out like a tracked object, so a full array still matches what it already tracks
+		long total_dist_IR = 0;
+		for (int j = segments[i].start; j <= segments[i].end; j++) // Average IR distance over every sample of the object
+			total_dist_IR += scan_data[j].ir_cm;
+		
+		object[ALL_ANGULAR_WIDTH] = segments[i].angular_width; // Log calculated object angular size
+		object[ALL_DISTANCE_SONAR] = segments[i].distance; // Log confidence weighted average of the fused distance
+		object[ALL_DISTANCE_IR] = total_dist_IR / (segments[i].end - segments[i].start + 1); // IR Distance = Average = Sum/N
+		object[ALL_LINEAR_WIDTH] = segments[i].linear_width; // Log calculated linear width
+		object[ALL_POSITION] = segments[i].start + segments[i].angular_width / 2.0; // Log calculated object angular position
+		float x = bot->x, y = bot->y;
+		geo_project(&x, &y, segments[i].distance, GEO_DEGREES(bot->angle - 90) + GEO_DEGREES(object[ALL_POSITION])); // Project from the robot along the servo angle. Binary angles wrap past 360 on their own.
+		object[ALL_X] = x; // Assign X coordinate of object in respect to the bot
+		object[ALL_Y] = y; // Assign Y coordinate of object in respect to the bot
+		
+		signed char index = associate_track(obst, object); // Same object as one we are already tracking?
+		if (index >= 0)
+			seen |= 1UL << index;
 	}
-	obst->last_dist_IR = obst->cur_dist_IR; // Remember the last measured IR distance
-	obst->last_dist_SONAR = obst->cur_dist_SONAR; // Remember last measured SONAR distance
+	
+	decay_tracks(obst, bot, seen); // Forget objects this sweep shows are gone
+	rec_log(REC_SCAN, found, obst->all_object_index, bot->angle);
+	
+	PROF_END(PROF_FIND_OBJS);
 }
 
 void find_smallest_obj(obstacle* obst) {
 	for (int i = 0; i < obst->all_object_index; i++)
-	if (obst->all_objects_array[i][ALL_LINEAR_WIDTH] < obst->smallest_obj_angular_size) {
+	if (obst->object_kind[i] == OBJECT_SWEPT && obst->all_objects_array[i][ALL_LINEAR_WIDTH] < obst->smallest_obj_angular_size) {
 		obst->smallest_obj_angular_size = obst->all_objects_array[i][ALL_ANGULAR_WIDTH];
 		obst->smallest_obj_linear_size = obst->all_objects_array[i][ALL_LINEAR_WIDTH];
 		obst->smallest_obj_dist_SONAR = obst->all_objects_array[i][ALL_DISTANCE_SONAR];
@@ -259,7 +302,7 @@ void find_smallest_obj(obstacle* obst) {
 
 void find_closest_obj(obstacle* obst) {
 	for (int i = 0; i < obst->all_object_index; i++)
-	if (obst->all_objects_array[i][ALL_DISTANCE_SONAR] < obst->closest_obj_dist_SONAR || obst->all_objects_array[i][ALL_DISTANCE_IR] < obst->closest_obj_dist_IR) {
+	if (obst->object_kind[i] == OBJECT_SWEPT && obst->all_objects_array[i][ALL_DISTANCE_SONAR] < obst->closest_obj_dist_SONAR) { // Distance is already fused from both sensors
 		obst->closest_obj_angular_size = obst->all_objects_array[i][ALL_ANGULAR_WIDTH];
 		obst->closest_obj_linear_size = obst->all_objects_array[i][ALL_LINEAR_WIDTH];
 		obst->closest_obj_dist_SONAR = obst->all_objects_array[i][ALL_DISTANCE_SONAR];
@@ -270,34 +313,105 @@ void find_closest_obj(obstacle* obst) {
 
 void print_and_process_stats(obstacle* obst) {
 	if (obst->all_object_index > 0) {
-		char buffer[500];
+		char buffer[200];
 	
-		/* Prepare buffer for transmission */
-		sprintf(buffer, "\r\n\nObjects found: %d\r\n\nClosest Object Statistics:\r\nObject position: %.1f degrees\r\nSONAR distance (cm): %d\r\nIR distance (cm): %d\r\nAngular width: %d\r\nLinear width (cm): %d\r\n\nSmallest Object Statistics:\r\nObject position: %.1lf degrees\r\nSONAR distance (cm): %d\r\nIR distance (cm): %d\r\nAngular width: %d\r\nLinear width (cm): %d\r\n", obst->all_object_index, obst->closest_obj_position, obst->closest_obj_dist_SONAR, obst->closest_obj_dist_IR, obst->closest_obj_angular_size, obst->closest_obj_linear_size, obst->smallest_obj_position, obst->smallest_obj_dist_SONAR, obst->smallest_obj_dist_IR, obst->smallest_obj_angular_size, obst->smallest_obj_linear_size);
+		/* Prepare buffer for transmission, one object at a time */
+		sprintf_P(buffer, PSTR("\r\n\nObjects found: %d\r\n\nClosest Object Statistics:\r\nObject position: %.1f degrees\r\nSONAR distance (cm): %d\r\nIR distance (cm): %d\r\nAngular width: %d\r\nLinear width (cm): %d\r\n"), obst->all_object_index, obst->closest_obj_position, obst->closest_obj_dist_SONAR, obst->closest_obj_dist_IR, obst->closest_obj_angular_size, obst->closest_obj_linear_size);
+		send_message(buffer);
+		sprintf_P(buffer, PSTR("\nSmallest Object Statistics:\r\nObject position: %.1lf degrees\r\nSONAR distance (cm): %d\r\nIR distance (cm): %d\r\nAngular width: %d\r\nLinear width (cm): %d\r\n"), obst->smallest_obj_position, obst->smallest_obj_dist_SONAR, obst->smallest_obj_dist_IR, obst->smallest_obj_angular_size, obst->smallest_obj_linear_size);
 		send_message(buffer);
 	} else {
-		send_message("\r\nNo objects found\r\n");
+		send_message_P(PSTR("\r\nNo objects found\r\n"));
 	}
 }
 
-void find_dupilicate(obstacle* obst, robot* bot){
-	char validation = 0;
-	for (int i = 0; i < obst->all_object_index - 1; i++) {
-		if (((obst->all_objects_array[i][ALL_X] - 8.5) < obst->all_objects_array[obst->all_object_index-1][ALL_X]) && ((obst->all_objects_array[i][ALL_X] + 8.5) > obst->all_objects_array[obst->all_object_index-1][ALL_X]))
-			validation++;
+void add_track(obstacle* obst, unsigned char confidence, unsigned char kind) {
+	if (obst->all_object_index >= MAX_OBJECTS)
+		return;
+	
+	obst->object_id[obst->all_object_index] = obst->next_object_id++;
+	obst->object_confidence[obst->all_object_index] = confidence;
+	obst->object_kind[obst->all_object_index] = kind;
+	obst->changed_objects |= 1UL << obst->all_object_index;
+	obst->all_object_index++;
+}
 
-		if (((obst->all_objects_array[i][ALL_Y] - 8.5) < obst->all_objects_array[obst->all_object_index-1][ALL_Y]) && ((obst->all_objects_array[i][ALL_Y] + 8.5) > obst->all_objects_array[obst->all_object_index-1][ALL_Y]))
-			validation++;
-		
-		if (((obst->all_objects_array[i][ALL_POSITION] - 8.5) < obst->all_objects_array[obst->all_object_index-1][ALL_POSITION]) && ((obst->all_objects_array[i][ALL_POSITION] + 8.5) > obst->all_objects_array[obst->all_object_index-1][ALL_POSITION]))
-			validation++;
+signed char associate_track(obstacle* obst, const float* object) {
+	int new_index = obst->all_object_index;
+	
+	for (int i = 0; i < new_index; i++) {
+		if (obst->object_kind[i] != OBJECT_SWEPT) // Hazards are never seen by a sweep
+			continue;
 		
-		if (((obst->all_objects_array[i][ALL_DISTANCE_SONAR] - 8.5) < obst->all_objects_array[obst->all_object_index-1][ALL_DISTANCE_SONAR]) && ((obst->all_objects_array[i][ALL_DISTANCE_SONAR] + 8.5) > obst->all_objects_array[obst->all_object_index-1][ALL_DISTANCE_SONAR]))
-			validation++;
+		float dx = obst->all_objects_array[i][ALL_X] - object[ALL_X];
+		float dy = obst->all_objects_array[i][ALL_Y] - object[ALL_Y];
 		
-		if (validation == 4) {
-			obst->all_object_index--;
+		if (dx * dx + dy * dy < TRACK_GATE * TRACK_GATE) { // Seen again. Average the position using how sure we are of each.
+			float weight = obst->object_confidence[i] / (float) (obst->object_confidence[i] + TRACK_CONFIDENCE_HIT);
+			obst->all_objects_array[i][ALL_X] -= dx * (1 - weight);
+			obst->all_objects_array[i][ALL_Y] -= dy * (1 - weight);
+			obst->all_objects_array[i][ALL_ANGULAR_WIDTH] = object[ALL_ANGULAR_WIDTH];
+			obst->all_objects_array[i][ALL_LINEAR_WIDTH] = object[ALL_LINEAR_WIDTH];
+			obst->all_objects_array[i][ALL_DISTANCE_IR] = object[ALL_DISTANCE_IR];
+			
+			if (obst->object_confidence[i] > TRACK_CONFIDENCE_MAX - TRACK_CONFIDENCE_HIT)
+				obst->object_confidence[i] = TRACK_CONFIDENCE_MAX;
+			else
+				obst->object_confidence[i] += TRACK_CONFIDENCE_HIT;
+			obst->changed_objects |= 1UL << i;
+			return i;
 		}
-		validation = 0;
 	}
-}
\ No newline at end of file
+	
+	if (new_index >= MAX_OBJECTS) // Never seen before, and no room to track it
+		return -1;
+	for (int j = 0; j < 7; j++)
+		obst->all_objects_array[new_index][j] = object[j];
+	add_track(obst, TRACK_CONFIDENCE_NEW, OBJECT_SWEPT); // Never seen before
+	return new_index;
+}
+
+void decay_tracks(obstacle* obst, robot* bot, unsigned long seen) {
+	for (int i = obst->all_object_index - 1; i >= 0; i--) { // Go backwards so removing an object doesn't skip the next one
+		if ((seen & (1UL << i)) || obst->object_kind[i] != OBJECT_SWEPT)
+			continue;
+		
+		int16_t dx = obst->all_objects_array[i][ALL_X] - bot->x;
+		int16_t dy = obst->all_objects_array[i][ALL_Y] - bot->y;
+		int distance = geo_hypot(dx, dy);
+		int angle = GEO_TO_DEGREES(geo_atan2(dy, dx) - GEO_DEGREES(bot->angle - 90)); // Servo angle the object should have been seen at
+		
+		if (angle < SMALL_OBJECT_SIZE_MIN || angle > 180 - SMALL_OBJECT_SIZE_MIN || distance > MAX_DETECTION_DISTANCE - TRACK_GATE) // Outside what the sweep could see
+			continue;
+		
+		int fused;
+		if (fuse_range(scan_data[angle].ir_cm, scan_sonar_cm(scan_data[angle].sonar_ticks), &fused) > 0 && fused < distance - TRACK_GATE) // Hidden behind something closer
+			continue;
+		
+		if (obst->object_confidence[i] <= TRACK_CONFIDENCE_MISS)
+			remove_track(obst, i);
+		else
+			obst->object_confidence[i] -= TRACK_CONFIDENCE_MISS;
+	}
+}
+
+void remove_track(obstacle* obst, char index) {
+	unsigned long below = (1UL << index) - 1;
+	
+	if (obst->removed_count < REMOVED_ID_MAX) {
+		obst->removed_ids[obst->removed_count++] = obst->object_id[(int) index];
+		obst->changed_objects = (obst->changed_objects & below) | ((obst->changed_objects >> 1) & ~below); // Later objects move down one
+	} else {
+		obst->resync_due = 1; // Too many to list. Resend everything.
+	}
+	
+	for (int i = index; i < obst->all_object_index - 1; i++) {
+		for (int j = 0; j < 7; j++)
+			obst->all_objects_array[i][j] = obst->all_objects_array[i + 1][j];
+		obst->object_id[i] = obst->object_id[i + 1];
+		obst->object_confidence[i] = obst->object_confidence[i + 1];
+		obst->object_kind[i] = obst->object_kind[i + 1];
+	}
+	
+	obst->all_object_index--;
+}
@@ -9,6 +9,9 @@
     \brief The file in which object tracking is handled.
 */
 
+#ifndef OBJECT_TRACKING_H
+#define OBJECT_TRACKING_H
+
 #include "open_interface.h"
 
 /* Bluetooth Definitions */
@@ -31,6 +34,38 @@
 */
 #define MAX_DETECTION_DISTANCE 50
 
+/*! \def MAX_OBJECTS
+	\brief Size of the object array
+*/
+#define MAX_OBJECTS 30
+
+/* Object Tracking Definitions */
+/*! \def TRACK_GATE
+	\brief A detection within this distance (in cm) of a tracked object is the same object
+*/
+#define TRACK_GATE 10
+/*! \def TRACK_CONFIDENCE_NEW
+	\brief Confidence of an object seen for the first time
+*/
+#define TRACK_CONFIDENCE_NEW 64
+/*! \def TRACK_CONFIDENCE_HIT
+	\brief Confidence gained each time an object is seen again
+*/
+#define TRACK_CONFIDENCE_HIT 64
+/*! \def TRACK_CONFIDENCE_MISS
+	\brief Confidence lost each time a sweep should have seen an object but didn't. The object is dropped at zero.
+*/
+#define TRACK_CONFIDENCE_MISS 64
+/*! \def TRACK_CONFIDENCE_MAX
+	\brief Highest confidence. Hazards found by the bumper and cliff sensors start here since a sweep can't see them.
+*/
+#define TRACK_CONFIDENCE_MAX 255
+
+/*! \def REMOVED_ID_MAX
+	\brief Number of removed objects remembered between reports. If more are removed, a full report is sent instead.
+*/
+#define REMOVED_ID_MAX 8
+
 /* Object Linear Width Definitions */
 /*! \def SMALL_OBJECT_SIZE_MIN
 	\brief Robot detects minimum linear width of smallest object as 3 cm
@@ -67,7 +102,7 @@
 */
 #define ALL_LINEAR_WIDTH 1
 /*! \def ALL_DISTANCE_SONAR
-	\brief Definition of the detected SONAR distance from the robot's ping sensor (located on the servo) to the object for use in the objects array
+	\brief Definition of the detected distance from the robot's servo mounted sensors to the object for use in the objects array. Fused from the IR and SONAR readings.
 */
 #define ALL_DISTANCE_SONAR 2
 /*! \def ALL_DISTANCE_IR
@@ -116,6 +151,28 @@
 	\brief Definition of the flat object linear width value (arbitrarily assigned)
 */
 #define FLAT 115
+/*! \def OBJECT_SWEPT
+	\brief Kind of an object found by a sweep. Hazards found by the bumper and cliff sensors are CLIFF, WHITE, RED, or FLAT instead.
+*/
+#define OBJECT_SWEPT 0
+
+/* Definitions for how a sweep is reported */
+/*! \def SWEEP_ROWS
+	\brief Send a text row for every degree while sweeping
+*/
+#define SWEEP_ROWS 0
+/*! \def SWEEP_BULK
+	\brief Send the whole sweep as one raw frame afterwards
+*/
+#define SWEEP_BULK 1
+/*! \def SWEEP_BULK_DELTA
+	\brief Send the whole sweep as one delta encoded frame afterwards
+*/
+#define SWEEP_BULK_DELTA 2
+/*! \def SWEEP_BULK_PACKED
+	\brief Send the whole sweep as one compressed frame afterwards
+*/
+#define SWEEP_BULK_PACKED 3
 
 //! Structure of detection variables. Written by Omar.
 /*! This is a structure for defining the obstacle detection variables. All the properties of the obstacle(s) detected are recorded here. */
@@ -123,16 +180,9 @@ typedef struct {
 	volatile float degrees; /*!< Updates the number of degrees turned by the servo. Initially set to zero. */
 	
 	volatile int cur_dist_IR; /*!< Finds and updates the IR distance from the robot to the object. Initially set to zero. */
-	volatile int last_dist_IR; /*!< Finds and updates the last IR distance found of the object. Initially set to zero. */
-	volatile int total_dist_IR; /*!< Total distance measured by the IR. Initially set to zero. */
-	volatile char start_angle_IR; /*!< This is used to calculate the object angular size. This variable is used to record the start angle at which the object was found. Initially set to zero. */
-	volatile char end_angle_IR; /*!< This is used to calculate the object angular size. This variable is used to record the last angle at which the object was found. Initially set to zero. */
-	volatile char object_detected : 1; /*!< Toggles when object has started and finished being detected. Can only process one object at a time. */
-	
 	volatile float cur_dist_SONAR; /*!< Finds and updates the SONAR distance from the robot to the object. Initially set to zero. */
-	volatile float last_dist_SONAR; /*!< Finds and updates the last IR distance found of the object. Initially set to zero. */
-	volatile char start_dist_SONAR; /*!< Records the first distance at which the object is found at by the SONAR. Initially set to zero. */
-	volatile char end_dist_SONAR; /*!< Records the last distance at which the object is found at  by the SONAR. Initially set to zero. */
+	volatile int cur_dist_fused; /*!< IR and SONAR distance at the current angle combined by fuse_range(). Initially set to zero. */
+	volatile unsigned char cur_confidence; /*!< Confidence (0-255) in cur_dist_fused. Initially set to zero. */
 	
 	volatile char smallest_obj_angular_size : 6; /*!< Finds and records the value of the angular size of the smallest object found. Initially set to 50. */
 	volatile char smallest_obj_linear_size : 5; /*!< Finds and records the value of the angular size of the smallest object found. Initially set to 11. */
@@ -146,23 +196,29 @@ typedef struct {
 	volatile int closest_obj_dist_IR; /*!< Finds and records the distance of the closest object using IR. Initially set to 2752. */
 	volatile float closest_obj_position; /*!< Finds and records the angular position of the closest object. Initially set to zero. */
 	
-	volatile char validation_level; /*!< This is the validation level variable which gets updated every time an object is detected. It is used to check for anomalies. */
-	
-	volatile float all_objects_array[30][7]; /*!< Storing all the objects found. There are 15 objects in total (30 to account for cliffs and bumper-detected objects), each with 9 parameters (Angular width, linear width, distance_sonar, distance_ir, angular position in respect to the bot, and, x & y coordinate).*/
+	volatile float all_objects_array[MAX_OBJECTS][7]; /*!< Storing all the objects found. There are 15 objects in total (30 to account for cliffs and bumper-detected objects), each with 9 parameters (Angular width, linear width, distance_sonar, distance_ir, angular position in respect to the bot, and, x & y coordinate).*/
 	volatile char all_object_index : 5;  /*!< Keeps track of the index of every object found.*/
+	volatile unsigned char object_id[MAX_OBJECTS]; /*!< ID of each object in the array. IDs stay the same as objects move around the array. */
+	volatile unsigned char object_confidence[MAX_OBJECTS]; /*!< Confidence (0-255) that each object in the array is really there. */
+	volatile unsigned char object_kind[MAX_OBJECTS]; /*!< OBJECT_SWEPT, or CLIFF, WHITE, RED, or FLAT for a hazard. */
+	volatile unsigned char next_object_id; /*!< ID given to the next new object. */
+	volatile unsigned long changed_objects; /*!< Bit i is set when object i was added or changed since the last report. */
+	volatile unsigned char removed_ids[REMOVED_ID_MAX]; /*!< IDs of the objects removed since the last report. */
+	volatile unsigned char removed_count; /*!< Number of IDs in removed_ids. */
+	volatile char resync_due; /*!< More objects were removed than removed_ids holds, so the next report starts the operator's table over. */
 	
 	
 } obstacle;
 
 //! Structure of robot variables. Written by Souparni and improved upon by Omar.
-/*! This is a structure for defining the robot's variables based on the idea of a Cartesian coordinate system. */
+/*! This is a structure for defining the robot's variables based on the idea of a Cartesian coordinate system. The pose follows the Create's odometry frame by frame (see pose.h). */
 typedef struct  
 {
 	float x; /*!< Defines and records the x coordinate position of the robot. Initially set to 0. */ 
 	float y; /*!< Defines and records the y coordinate position of the robot. Initially set to 0. */  
 	float angle; /*!< Defines and records the angle of the robot. Initially set to 90. */
-	float dist_traveled; /*!< Defines and records the total distance traveled by the robot. Initially set to zero. Reset after every movement. */
 	char initialized : 1; /*!< Checks if the robot is initialized. Returns 1 or 0 (True or false) */
+	char pose_changed : 1; /*!< Set when the coordinates or angle changed since the last report. */
 	
 } robot;
 
@@ -197,15 +253,16 @@ void initalizations(obstacle* obst, robot* bot, control* c);
 
 /// Performs a sweep to detect the closest objects. Written by Omar.
 /**
-* Perform 180 degree sweep, finding the smallest and closest object in the process.
+* Perform 180 degree sweep into scan_data, then find the objects in it and the smallest and closest object. With SWEEP_ROWS every degree is sent as a text row while sweeping; otherwise nothing is sent until the servo is done and then the whole sweep goes out as one scan_send_bulk() frame, so the sweep doesn't wait on bluetooth. When the battery is low (see energy.h) only every second or third degree is sampled, and the degrees in between hold the sample before them.
 * @param obst the pointer used to refer to the variables in the obstacle struct. Specifically the cur_dist_IR, and the cur_dist_SONAR variables that are updated constantly.
 * @param bot the pointer used to refer to the variables in the robot struct. The bot variables are being updated by calling other methods inside this method.
+* @param bulk SWEEP_ROWS, SWEEP_BULK, SWEEP_BULK_DELTA, or SWEEP_BULK_PACKED
 */
-void sweep(obstacle* obst, robot* bot);
+void sweep(obstacle* obst, robot* bot, char bulk);
 
 /// Finds the linear width of the object detected. Written by Dalton and improved upon by Omar.
 /**
-* Finds the linear width of a detected object, after finding object's distance and angular width first. [sin((pi/180) * theta) * hypotenuse].
+* Finds the linear width of a detected object, after finding object's distance and angular width first. [2 * distance * tan(theta / 2)], see linear_width_cm().
 * @param obst the pointer used to refer to the variables in the obstacle struct.
 * @return the linear width of the object
 */
@@ -213,12 +270,20 @@ char get_linear_width(obstacle* obst);
 
 /// Updates the information of detected obstacles and the robot. Written by Omar and Louis.
 /**
-* Updates the information of detected obstacles and the robot based on equations related to a Cartesian coordinate system.
+* Updates the information of detected obstacles and the robot based on equations related to a Cartesian coordinate system. Only objects that changed since the last report are sent, along with the IDs of removed objects and the robot's position if it moved. Use request_full_report() to send everything. If more than REMOVED_ID_MAX objects were removed, it sends a full report instead, so the operator drops the ones it wasn't told about.
 * @param obst the pointer used to refer to the variables in the obstacle struct. Necessary to update the distance and direction of the logged obstacles in relation to the robot.
 * @param bot the pointer used to refer to the variables in the robot struct. Necessary to update the direction the robot is facing as well as its coordinates.
 */
 void update_information(obstacle* obst, robot* bot);
 
+/// Makes the next update_information() send every object and the robot's position.
+/**
+* Sends the "Tracking N objects" header right away, which tells the operator to start a new table.
+* @param obst the pointer used to refer to the variables in the obstacle struct.
+* @param bot the pointer used to refer to the variables in the robot struct.
+*/
+void request_full_report(obstacle* obst, robot* bot);
+
 /// Finds the smallest object out of the found objects. Written by Omar.
 /**
 * Finds the smallest object out of the found objects by comparing the linear width of each found object with a predefined width of the smallest object. It then sets the width of the smallest object.
@@ -228,7 +293,7 @@ void find_smallest_obj(obstacle* obst);
 
 /// Find any objects and log their stats in the object array. Written by Omar.
 /**
-* Logs the angle and the distance of every object detected and stores it into an all_objects_array array. This method can be called in order to find any specific object.
+* Runs scan_segment_objects() over the completed sweep in scan_data and logs the angle and the distance of every object found into the all_objects_array array.
 * @param obst the pointer used to refer to the variables in the obstacle struct. All the angles and distances of the obstacles are updated.
 * @param bot the pointer used to refer to the variables in the robot struct.
 */
@@ -248,13 +313,39 @@ void find_closest_obj(obstacle* obst);
 */
 void print_and_process_stats(obstacle* obst);
 
-/// Finding the duplicate object. Written by Louis.
+/// Adds the object at all_object_index as a new tracked object.
 /**
-* If there is a duplicate object found, it is not logged. This method makes sure the same object is not logged twice.
-* @param obst the pointer used to refer to the variables in the obstacle struct. A specific object is passed and checked if it is a duplicate.
-* @param bot the pointer used to refer to the variables in the robot struct.
+* Gives the object the next ID and moves all_object_index past it. Does nothing if the array is full.
+* @param obst the pointer used to refer to the variables in the obstacle struct.
+* @param confidence starting confidence of the object
+* @param kind OBJECT_SWEPT, or CLIFF, WHITE, RED, or FLAT for a hazard
+*/
+void add_track(obstacle* obst, unsigned char confidence, unsigned char kind);
+
+/// Matches a detection to the tracked objects. Replaces the duplicate check written by Louis.
+/**
+* If the detection is within TRACK_GATE of a tracked object found by a sweep, the tracked object's position is averaged with it and its confidence is raised. Otherwise it is added as a new object, if there is room.
+* @param obst the pointer used to refer to the variables in the obstacle struct. The detection is checked against every tracked object.
+* @param object the detection, laid out like a row of all_objects_array
+* @return the index of the tracked object the detection was matched to or added as, or -1 if it is new and the array is full
 */
-void find_dupilicate(obstacle* obst, robot* bot);
+signed char associate_track(obstacle* obst, const float* object);
+
+/// Lowers the confidence of objects a sweep should have seen but didn't.
+/**
+* An object should have been seen if it is in front of the robot, within detection range, and nothing closer was hiding it. Objects whose confidence reaches zero are removed. Hazards found by the bumper and cliff sensors are never removed.
+* @param obst the pointer used to refer to the variables in the obstacle struct.
+* @param bot the pointer used to refer to the variables in the robot struct. Needed to know what the sweep could see.
+* @param seen bit i is set if object i was matched by the sweep
+*/
+void decay_tracks(obstacle* obst, robot* bot, unsigned long seen);
+
+/// Removes an object from the array.
+/**
+* @param obst the pointer used to refer to the variables in the obstacle struct.
+* @param index the index of the object to remove. Objects after it move down one.
+*/
+void remove_track(obstacle* obst, char index);
 
 /// Resets the object array. Written by Omar.
 /**
@@ -268,4 +359,6 @@ void reset_object_array(obstacle* obst);
 * We are setting the x and y coordinate and the angle and distance traveled to zero.
 * @param bot the robot to be reset.
 */
-void reinitialize_bot(robot* bot);
\ No newline at end of file
+void reinitialize_bot(robot* bot);
+
+#endif
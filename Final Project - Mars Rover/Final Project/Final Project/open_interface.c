@@ -1,6 +1,15 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include "util.h"
 #include "open_interface.h"
+#include "profile.h"
+#include "recorder.h"
+#include "idle.h"
+#include "energy.h"
 
 /// Allocate memory for a the sensor data
 oi_t* oi_alloc() {
@@ -12,74 +21,415 @@ void oi_free(oi_t *self) {
 	free(self);
 }
 
+uint32_t oi_baud;
+volatile uint16_t oi_link_errors;
+static char oi_link_verified; // Did a baud rate pass oi_link_ok()?
+
+/// Baud rates to try, fastest first. If none pass, the Create is put back at its power on rate.
+static const struct {
+	uint8_t code;
+	uint32_t baud;
+} oi_baud_rates[] = {
+	{OI_BAUD_115200, 115200},
+	{OI_BAUD_57600, 57600},
+	{OI_BAUD_38400, 38400} // Slowest that fits a packet group 6 frame in the 15 ms stream period
+};
+
+/// Entry in oi_baud_rates the Create powers on at
+#define OI_BAUD_START 1
+
+/// Sets USART1 to a baud rate in double speed mode
+static void oi_set_baud(uint32_t baud) {
+	uint16_t ubrr = (FOSC + 4 * baud) / (8 * baud) - 1; // UBRR = FOSC/8/BAUD-1, rounded
+	
+	UBRR1H = ubrr >> 8;
+	UBRR1L = ubrr;
+	UCSR1A = (1 << U2X);
+	oi_baud = baud;
+}
+
+/// Error of the baud rate USART1 actually makes, in tenths of a percent
+static uint16_t oi_baud_error(uint32_t baud) {
+	uint16_t ubrr = (FOSC + 4 * baud) / (8 * baud) - 1;
+	int32_t actual = FOSC / (8 * (ubrr + 1UL));
+	int32_t error = (actual - (int32_t) baud) * 1000 / (int32_t) baud;
+	
+	return (error < 0) ? -error : error;
+}
+
+/// Receive a byte, giving up after time_ms. Returns -1 on timeout or a framing, overrun, or parity error.
+static int oi_byte_rx_timeout(unsigned int time_ms) {
+	unsigned long start = uptime_ticks();
+	
+	while (!(UCSR1A & (1 << RXC)))
+		if (uptime_ticks() - start > time_ms * 250UL) // 4 us ticks
+			return -1;
+	
+	uint8_t status = UCSR1A;
+	uint8_t data = UDR1;
+	return (status & ((1 << FE) | (1 << DOR) | (1 << UPE))) ? -1 : data;
+}
+
+/// Streams the OI mode packet and checks that OI_LINK_TEST_FRAMES frames in a row arrive with a good checksum
+static char oi_link_ok(void) {
+	char good = 0;
+	
+	while (UCSR1A & (1 << RXC)) // Clear the receive buffer
+		UDR1;
+	
+	oi_byte_tx(OI_OPCODE_STREAM);
+	oi_byte_tx(1);
+	oi_byte_tx(OI_SENSOR_OI_MODE);
+	
+	for (int tries = 0; tries < 2 * OI_LINK_TEST_FRAMES && good < OI_LINK_TEST_FRAMES; tries++) {
+		int header = oi_byte_rx_timeout(50); // A frame comes every 15 ms
+		if (header != OI_STREAM_HEADER) {
+			good = 0;
+			continue;
+		}
+		
+		uint8_t sum = header;
+		char ok = 1;
+		for (int i = 0; i < 4; i++) { // Byte count, packet id, mode, checksum
+			int b = oi_byte_rx_timeout(10);
+			if (b < 0)
+				ok = 0;
+			sum += b;
+		}
+		good = (ok && sum == 0) ? good + 1 : 0;
+	}
+	
+	oi_byte_tx(OI_OPCODE_DO_STREAM); // Pause the stream
+	oi_byte_tx(0);
+	wait_ms(20);
+	while (UCSR1A & (1 << RXC)) // Drop whatever was still on its way
+		UDR1;
+	
+	return good == OI_LINK_TEST_FRAMES;
+}
+
+/// Sends the Create the baud command for oi_baud_rates[to] at the rate it was last told, the one before, and its power on rate, until the link passes
+static char oi_switch_baud(uint8_t to, uint32_t last, uint32_t before) {
+	uint32_t from[3] = {last, before, oi_baud_rates[OI_BAUD_START].baud};
+	
+	for (int i = 0; i < 3; i++) {
+		if ((i > 0 && from[i] == from[0]) || (i > 1 && from[i] == from[1])) // Already tried from there
+			continue;
+		
+		oi_set_baud(from[i]);
+		oi_byte_tx(OI_OPCODE_BAUD);
+		oi_byte_tx(oi_baud_rates[to].code);
+		wait_ms(100); // Also lets the command finish sending before our speed changes
+		oi_set_baud(oi_baud_rates[to].baud);
+		
+		if (oi_link_ok())
+			return 1;
+	}
+	return 0;
+}
+
 /// Initialize the Create
 void oi_init(oi_t *self) {
-	// Setup USART1 to communicate to the iRobot Create using serial (baud = 57600)
-	UBRR1L = 16; // UBRR = (FOSC/16/BAUD-1);
+	// Setup USART1 to communicate to the iRobot Create at its power on baud rate
+	oi_set_baud(57600);
 	UCSR1B = (1 << RXEN) | (1 << TXEN);
 	UCSR1C = (3 << UCSZ10);
 
 	// Starts the SCI. Must be sent first
 	oi_byte_tx(OI_OPCODE_START);
-	oi_byte_tx(OI_OPCODE_BAUD);
-
-	oi_byte_tx(8); // baud code for 28800
-	wait_ms(100);
 	
-	// Set the baud rate on the Cerebot II to match the Create's baud
-	UBRR1L = 33; // UBRR = (FOSC/16/BAUD-1);
+	// Switch both ends to the fastest baud rate that works. After a failure the Create may have taken the switch or missed it, so the next one is sent at every rate it could be listening at.
+	uint32_t last = oi_baud_rates[OI_BAUD_START].baud, before = last;
+	oi_link_verified = 0;
+	for (uint8_t i = 0; i < sizeof(oi_baud_rates) / sizeof(oi_baud_rates[0]); i++) {
+		if (oi_baud_error(oi_baud_rates[i].baud) > OI_BAUD_MAX_ERROR)
+			continue;
+		
+		oi_link_verified = oi_switch_baud(i, last, before);
+		if (oi_link_verified)
+			break;
+		before = last;
+		last = oi_baud_rates[i].baud;
+	}
+	if (!oi_link_verified) // Nothing passed; the power on rate is the best guess
+		oi_link_verified = oi_switch_baud(OI_BAUD_START, last, before);
+	oi_link_errors = 0;
 
 	// Use Full mode, unrestricted control
 	oi_byte_tx(OI_OPCODE_FULL);
 	oi_set_leds(1, 1, 7, 255);
 	
+	// Stream packet group 6. Frames are decoded as they arrive by the USART1 receive interrupt.
+	UCSR1B |= (1 << RXCIE1);
+	oi_byte_tx(OI_OPCODE_STREAM);
+	oi_byte_tx(1);
+	oi_byte_tx(OI_SENSOR_PACKET_GROUP6);
+	
 	oi_update(self);
 	oi_update(self); // call twice to clear distance/angle
 }
 
 
 
-/// Update the Create. This will update all the sensor data and store it in the oi_t struct.
-void oi_update(oi_t *self) {
-	int i;
+/// Decoder state for the sensor stream
+#define OI_RX_HEADER   0 // Looking for OI_STREAM_HEADER
+#define OI_RX_COUNT    1 // Expecting the byte count
+#define OI_RX_ID       2 // Expecting the packet id
+#define OI_RX_DATA     3 // Reading packet bytes
+#define OI_RX_CHECKSUM 4 // Expecting the checksum
+
+static volatile oi_t oi_rx;              // Latest good frame; distance and angle add up until oi_update() takes them
+static volatile uint8_t oi_rx_fresh;     // Has a good frame arrived since the last oi_update()?
+static volatile unsigned long oi_rx_time; // When the latest good frame arrived
+static unsigned long oi_time;            // When the frame oi_update() last returned arrived
+static uint8_t oi_rx_state = OI_RX_HEADER;
+static uint8_t oi_rx_data[OI_SENSOR_PACKET_GROUP6_SIZE];
+static uint8_t oi_rx_index;
+static uint8_t oi_rx_sum;
+static uint8_t oi_rx_lost;               // Bytes skipped since the last good frame
+
+volatile uint16_t oi_frames_good;
+volatile uint16_t oi_frames_bad;
+volatile uint16_t oi_resyncs;
+
+static volatile uint8_t oi_tx_busy;       // Main code is in the middle of sending a command
+static volatile uint8_t oi_stop_pending;  // Watchdog is waiting for that command to finish to stop the wheels
+static volatile uint8_t oi_moving;        // Were the wheels last told to turn?
+static volatile uint8_t oi_hazards;       // Hazards seen but not yet taken by oi_hazard_take()
+static uint8_t oi_hazards_last;           // Hazards present in the previous frame
+static unsigned long oi_hazard_time;      // When the watchdog saw the hazard it is stopping for
+volatile uint16_t oi_hazard_stops;
+volatile unsigned long oi_hazard_latency_max;
+
+/// Big endian 16-bit value at p
+#define OI_WORD(p) ((uint16_t) ((p)[0] << 8) | (p)[1])
+
+/// Unpacks packet group 6 field by field, so nothing depends on how the compiler lays out oi_t
+static void oi_decode(const uint8_t *p, volatile oi_t *o) {
+	o->bumper_right             = p[0] & 0x01;
+	o->bumper_left              = (p[0] >> 1) & 0x01;
+	o->wheeldrop_right          = (p[0] >> 2) & 0x01;
+	o->wheeldrop_left           = (p[0] >> 3) & 0x01;
+	o->wheeldrop_caster         = (p[0] >> 4) & 0x01;
+	o->wall                     = p[1];
+	o->cliff_left               = p[2];
+	o->cliff_frontleft          = p[3];
+	o->cliff_frontright         = p[4];
+	o->cliff_right              = p[5];
+	o->virtual_wall             = p[6];
+	o->overcurrent_ld1          = p[7] & 0x01;
+	o->overcurrent_ld0          = (p[7] >> 1) & 0x01;
+	o->overcurrent_ld2          = (p[7] >> 2) & 0x01;
+	o->overcurrent_driveright   = (p[7] >> 3) & 0x01;
+	o->overcurrent_driveleft    = (p[7] >> 4) & 0x01;
+	o->unused_bytes             = OI_WORD(&p[8]);
+	o->infrared_byte            = p[10];
+	o->button_play              = p[11] & 0x01;
+	o->button_advance           = (p[11] >> 2) & 0x01;
+	o->distance                += (int16_t) OI_WORD(&p[12]); // Since the last frame, so it adds up
+	o->angle                   += (int16_t) OI_WORD(&p[14]);
+	o->charging_state           = p[16];
+	o->voltage                  = OI_WORD(&p[17]);
+	o->current                  = OI_WORD(&p[19]);
+	o->temperature              = p[21];
+	o->charge                   = OI_WORD(&p[22]);
+	o->capacity                 = OI_WORD(&p[24]);
+	o->wall_signal              = OI_WORD(&p[26]);
+	o->cliff_left_signal        = OI_WORD(&p[28]);
+	o->cliff_frontleft_signal   = OI_WORD(&p[30]);
+	o->cliff_frontright_signal  = OI_WORD(&p[32]);
+	o->cliff_right_signal       = OI_WORD(&p[34]);
+	o->cargo_bay_io0            = p[36] & 0x01;
+	o->cargo_bay_io1            = (p[36] >> 1) & 0x01;
+	o->cargo_bay_io2            = (p[36] >> 2) & 0x01;
+	o->cargo_bay_io3            = (p[36] >> 3) & 0x01;
+	o->cargo_bay_baud           = (p[36] >> 4) & 0x01;
+	o->cargo_bay_voltage        = OI_WORD(&p[37]);
+	o->internal_charger_on      = p[39] & 0x01;
+	o->home_base_charger_on     = (p[39] >> 1) & 0x01;
+	o->oi_mode                  = p[40];
+	o->song_number              = p[41];
+	o->song_playing             = p[42];
+	o->number_packets           = p[43];
+	o->requested_velocity       = OI_WORD(&p[44]);
+	o->requested_radius         = OI_WORD(&p[46]);
+	o->requested_right_velocity = OI_WORD(&p[48]);
+	o->requested_left_velocity  = OI_WORD(&p[50]);
+}
 
-	// Clear the receive buffer
-	while (UCSR1A & (1 << RXC)) 
-		i = UDR1;
+/// Stops the wheels for the watchdog. Must run with interrupts off so no other command can interleave with it.
+static void oi_watchdog_stop(void) {
+	oi_byte_tx(OI_OPCODE_DRIVE_WHEELS);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	
+	unsigned long latency = uptime_ticks() - oi_hazard_time;
+	if (latency > oi_hazard_latency_max)
+		oi_hazard_latency_max = latency;
+	oi_hazard_stops++;
+	oi_moving = 0;
+	oi_stop_pending = 0;
+}
 
-	// Query a list of sensor values
-	oi_byte_tx(OI_OPCODE_SENSORS);
-	// Send the sensor packet ID
-	oi_byte_tx(OI_SENSOR_PACKET_GROUP6); 
+void oi_tx_begin(void) {
+	oi_tx_busy = 1;
+}
 
-	// Read all the sensor data
-	char *sensor = (char *) self;
-	for (i = 0; i < 52; i++) {
-		// read each sensor byte
-		*(sensor++) = oi_byte_rx();
+void oi_tx_end(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		oi_tx_busy = 0;
+		if (oi_stop_pending)
+			oi_watchdog_stop();
 	}
+}
+
+/// Checks the frame just decoded for bumps, cliffs, and wheel drops. Runs in the receive interrupt.
+static void oi_watchdog(void) {
+	uint8_t now = 0;
 	
-	sensor = (char *) self;
+	if (oi_rx.bumper_left || oi_rx.bumper_right)
+		now |= OI_HAZARD_BUMP;
+	if (oi_rx.cliff_left || oi_rx.cliff_frontleft || oi_rx.cliff_frontright || oi_rx.cliff_right)
+		now |= OI_HAZARD_CLIFF;
+	if (oi_rx.wheeldrop_left || oi_rx.wheeldrop_right || oi_rx.wheeldrop_caster)
+		now |= OI_HAZARD_WHEELDROP;
 	
-	// Fix byte ordering for multi-byte members of the struct
-	self->distance                 = (sensor[12] << 8) + sensor[13];
-	self->angle                    = (sensor[14] << 8) + sensor[15];
-	self->voltage                  = (sensor[17] << 8) + sensor[18];
-	self->current                  = (sensor[19] << 8) + sensor[20];
-	self->charge                   = (sensor[22] << 8) + sensor[23];
-	self->capacity                 = (sensor[24] << 8) + sensor[25];
-	self->wall_signal              = (sensor[26] << 8) + sensor[27];
-	self->cliff_left_signal        = (sensor[28] << 8) + sensor[29];
-	self->cliff_frontleft_signal   = (sensor[30] << 8) + sensor[31]; 
-	self->cliff_frontright_signal  = (sensor[32] << 8) + sensor[33];
-	self->cliff_right_signal       = (sensor[34] << 8) + sensor[35];
-	self->cargo_bay_voltage        = (sensor[41] << 8) + sensor[42];
-	self->requested_velocity       = (sensor[48] << 8) + sensor[42];
-	self->requested_radius         = (sensor[50] << 8) + sensor[51];
-	self->requested_right_velocity = (sensor[52] << 8) + sensor[53];
-	self->requested_left_velocity  = (sensor[54] << 8) + sensor[55];
+	uint8_t started = now & ~oi_hazards_last; // Only a new hazard stops the wheels, so the robot can still back away from one
+	oi_hazards_last = now;
 	
-	wait_ms(35); // reduces USART errors that occur when continuously transmitting/receiving
+	if (!started)
+		return;
+	
+	oi_hazards |= started;
+	if (oi_moving) {
+		oi_hazard_time = uptime_ticks();
+		if (oi_tx_busy) // Finish the command being sent first
+			oi_stop_pending = 1;
+		else
+			oi_watchdog_stop();
+	}
+}
+
+uint8_t oi_hazard_take(void) {
+	uint8_t hazards;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		hazards = oi_hazards;
+		oi_hazards = 0;
+	}
+	return hazards;
+}
+
+/// A frame didn't check out. Look for the next header, which may be the byte that broke this one.
+static void oi_rx_resync(uint8_t data) {
+	oi_frames_bad++;
+	oi_rx_lost = 1;
+	oi_rx_state = OI_RX_HEADER;
+	
+	if (data == OI_STREAM_HEADER) {
+		oi_resyncs++;
+		oi_rx_lost = 0;
+		oi_rx_sum = data;
+		oi_rx_state = OI_RX_COUNT;
+	}
+}
+
+/* Byte of the sensor stream from the Create. Frame: OI_STREAM_HEADER, byte count, packet id 6, 52 bytes, checksum. */
+ISR(USART1_RX_vect)
+{
+	uint8_t status = UCSR1A;
+	uint8_t data = UDR1;
+	
+	if (status & ((1 << FE) | (1 << DOR) | (1 << UPE))) { // Byte is garbage; so is the frame it was in
+		oi_link_errors++;
+		if (oi_rx_state != OI_RX_HEADER)
+			oi_rx_resync(0);
+		return;
+	}
+	
+	oi_rx_sum += data;
+	
+	if (oi_rx_state == OI_RX_HEADER) {
+		if (data == OI_STREAM_HEADER) {
+			if (oi_rx_lost) // Had to skip bytes to find it
+				oi_resyncs++;
+			oi_rx_lost = 0;
+			oi_rx_sum = data;
+			oi_rx_state = OI_RX_COUNT;
+		} else {
+			oi_rx_lost = 1;
+		}
+	} else if (oi_rx_state == OI_RX_COUNT) {
+		if (data == OI_SENSOR_PACKET_GROUP6_SIZE + 1) {
+			oi_rx_state = OI_RX_ID;
+		} else { // Wasn't really a header
+			oi_rx_resync(data);
+		}
+	} else if (oi_rx_state == OI_RX_ID) {
+		if (data == OI_SENSOR_PACKET_GROUP6) {
+			oi_rx_index = 0;
+			oi_rx_state = OI_RX_DATA;
+		} else {
+			oi_rx_resync(data);
+		}
+	} else if (oi_rx_state == OI_RX_DATA) {
+		oi_rx_data[oi_rx_index++] = data;
+		if (oi_rx_index == OI_SENSOR_PACKET_GROUP6_SIZE)
+			oi_rx_state = OI_RX_CHECKSUM;
+	} else {
+		if (oi_rx_sum == 0) { // Everything from the header through the checksum adds up to 0
+			oi_decode(oi_rx_data, &oi_rx);
+			oi_watchdog();
+			oi_rx_fresh = 1;
+			oi_rx_time = uptime_ticks();
+			oi_frames_good++;
+			oi_rx_state = OI_RX_HEADER;
+		} else {
+			oi_rx_resync(0);
+		}
+	}
+}
+
+/// Update the Create. This will update all the sensor data and store it in the oi_t struct.
+void oi_update(oi_t *self) {
+	PROF_BEGIN(PROF_OI_UPDATE);
+	
+	// Sleep until a frame newer than the last one read arrives. The Create sends one every 15 ms.
+	unsigned long start = uptime_ticks();
+	idle_alarm(start + OI_FRAME_TIMEOUT * 250UL); // 4 us ticks
+	cli();
+	while (!oi_rx_fresh && uptime_ticks() - start < OI_FRAME_TIMEOUT * 250UL)
+		idle_sleep();
+	sei();
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		memcpy(self, (const void *) &oi_rx, sizeof(oi_t)); // Latest good frame, or the last one if the Create went quiet
+		oi_rx.distance = 0;
+		oi_rx.angle = 0;
+		oi_rx_fresh = 0;
+		oi_time = oi_rx_time;
+	}
+	
+	rec_oi(self);
+	energy_update(self);
+	PROF_END(PROF_OI_UPDATE);
+}
+
+unsigned long oi_frame_time(void) {
+	return oi_time;
+}
+
+void oi_link_report(void) {
+	char buffer[120];
+	
+	sprintf_P(buffer, PSTR("\r\nCreate link: %lu baud, %u good frames, %u bad frames, %u resyncs, %u USART errors\r\n"), (unsigned long) oi_baud, oi_frames_good, oi_frames_bad, oi_resyncs, oi_link_errors);
+	send_message(buffer);
+	if (!oi_link_verified)
+		send_message_P(PSTR("Baud rate unverified: no rate passed the stream check at start up\r\n"));
+	sprintf_P(buffer, PSTR("Hazard stops: %u, longest reaction %lu us\r\n"), oi_hazard_stops, oi_hazard_latency_max * 4);
+	send_message(buffer);
 }
 
 
@@ -93,6 +443,8 @@ void oi_update(oi_t *self) {
 * @power_intensity uint8_t the intensity of the power LED; 0 = off, 255 = full intensity
 */
 void oi_set_leds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uint8_t power_intensity) {
+	oi_tx_begin();
+	
 	// LED Opcode
 	oi_byte_tx(OI_OPCODE_LEDS);
 
@@ -104,23 +456,29 @@ void oi_set_leds(uint8_t play_led, uint8_t advance_led, uint8_t power_color, uin
 
 	// Set the power led intensity
 	oi_byte_tx(power_intensity);
+	
+	oi_tx_end();
 }
 
 
 
 /// Drive wheels directly; speeds are in mm / sec
 void oi_set_wheels(int16_t right_wheel, int16_t left_wheel) {
+	oi_tx_begin();
 	oi_byte_tx(OI_OPCODE_DRIVE_WHEELS);
 	oi_byte_tx(right_wheel>>8);
 	oi_byte_tx(right_wheel & 0xff);
 	oi_byte_tx(left_wheel>>8);
 	oi_byte_tx(left_wheel& 0xff);
+	oi_moving = (right_wheel != 0 || left_wheel != 0);
+	oi_tx_end();
 }
 
 
 /// Loads a song onto the iRobot Create
 void oi_load_song(int song_index, int num_notes, unsigned char *notes, unsigned char *duration) {
 	int i;
+	oi_tx_begin();
 	oi_byte_tx(OI_OPCODE_SONG);
 	oi_byte_tx(song_index);
 	oi_byte_tx(num_notes);
@@ -128,31 +486,28 @@ void oi_load_song(int song_index, int num_notes, unsigned char *notes, unsigned
 		oi_byte_tx(notes[i]);
 		oi_byte_tx(duration[i]);
 	}
+	oi_tx_end();
 }
 
 
 /// Plays a given song; use oi_load_song(...) first
 void oi_play_song(int index){
+	oi_tx_begin();
 	oi_byte_tx(OI_OPCODE_PLAY);
 	oi_byte_tx(index);
+	oi_tx_end();
 }
 
 
 /// Runs default go charge program; robot will search for dock
 void go_charge(void) {
-	char charging_state=0;
-	
 	//Calling demo that will cause Create to seek out home base
+	oi_tx_begin();
 	oi_byte_tx(OI_OPCODE_MAX);
 	oi_byte_tx(0x01);
+	oi_tx_end();
 	
-	//Control is returned immediately, so need to check for docking status
-	DDRB &= ~0x80; //Setting pin7 to input
-	PORTB |= 0x80; //Setting pullup on pin7
-	
-	do {
-		charging_state = PINB >> 7;
-	} while (charging_state == 0);
+	//Control is returned immediately; the charging state in the sensor frames shows when it has docked
 }
 
 
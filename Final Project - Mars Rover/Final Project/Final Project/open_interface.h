@@ -74,6 +74,41 @@
 #define OI_SENSOR_PACKET_GROUP5 5
 // Contains Packets 7-42
 #define OI_SENSOR_PACKET_GROUP6 6
+// Size of packet group 6 in bytes
+#define OI_SENSOR_PACKET_GROUP6_SIZE 52
+// OI mode, 1 byte
+#define OI_SENSOR_OI_MODE 35
+
+// Header byte of every stream frame
+#define OI_STREAM_HEADER 19
+
+// Baud codes for OI_OPCODE_BAUD
+#define OI_BAUD_28800  8
+#define OI_BAUD_38400  9
+#define OI_BAUD_57600  10
+#define OI_BAUD_115200 11
+
+// Baud rates with a UBRR error (at U2X) above this, in tenths of a percent, are not tried
+#define OI_BAUD_MAX_ERROR 25
+// Stream frames that must arrive intact before a baud rate is used
+#define OI_LINK_TEST_FRAMES 3
+// Longest oi_update() waits for a new stream frame, in ms
+#define OI_FRAME_TIMEOUT 50
+
+// OI modes reported in sensor packet 35
+#define OI_MODE_OFF     0
+#define OI_MODE_PASSIVE 1
+#define OI_MODE_SAFE    2
+#define OI_MODE_FULL    3
+
+// Charging states reported in sensor packet 21
+#define OI_CHARGING_NONE  0
+#define OI_CHARGING_FAULT 5
+
+// Hazards the watchdog stops the wheels for
+#define OI_HAZARD_BUMP      0x01
+#define OI_HAZARD_CLIFF     0x02
+#define OI_HAZARD_WHEELDROP 0x04
 
 #define MIN(a,b) ((a < b) ? (a) : (b))
 #define MAX(a,b) ((a > b) ? (a) : (b))
@@ -161,14 +196,62 @@ typedef oi_t oi_sensors_t;
 /// Allocate memory for the oi_sensor_t struct 
 oi_t * oi_alloc();
 
+/// Baud rate oi_init() settled on.
+extern uint32_t oi_baud;
+
+/// Bytes from the Create that had a framing, overrun, or parity error since oi_init().
+extern volatile uint16_t oi_link_errors;
+
+/// Stream frames that passed their checksum.
+extern volatile uint16_t oi_frames_good;
+
+/// Stream frames dropped for a bad byte count, packet id, checksum, or USART error.
+extern volatile uint16_t oi_frames_bad;
+
+/// Times bytes had to be skipped to find the next frame header.
+extern volatile uint16_t oi_resyncs;
+
+/// Times the hazard watchdog stopped the wheels.
+extern volatile uint16_t oi_hazard_stops;
+
+/// Longest time from the watchdog seeing a hazard to the stop command going out, in timer 1 ticks (4 us).
+extern volatile unsigned long oi_hazard_latency_max;
+
 /// Initialize the Create. This must be called first.
+/// Tries the fastest baud rate the UBRR can hit closely first, and keeps the first one that passes a streamed sensor check.
+/// If none passes, it goes back to 57600, and oi_link_report() says the link is unverified.
 void oi_init(oi_t *self);
 
 void oi_free(oi_t *self);
 
 /// Update the Create. This will update all the sensor data.
+/// Sleeps until the next good stream frame (up to OI_FRAME_TIMEOUT ms). distance and angle are the totals since the last call.
 void oi_update(oi_t *self);
 
+/// When the frame the last oi_update() returned arrived.
+/**
+* @return uptime_ticks() at the end of the frame
+*/
+unsigned long oi_frame_time(void);
+
+/// Sends the baud rate (and whether it passed the check in oi_init()), stream frame counters, and hazard watchdog statistics over bluetooth.
+void oi_link_report(void);
+
+/// Takes the hazards the watchdog has seen since the last call.
+/**
+* Every sensor frame is checked as it arrives. When a bump, cliff, or wheel drop starts while the wheels are turning,
+* the wheels are stopped right there (or as soon as the command being sent is finished), whatever the main loop is doing.
+* A motion loop that sees a hazard here should stop waiting on odometry, since the robot is no longer moving.
+* @return OI_HAZARD_ bits
+*/
+uint8_t oi_hazard_take(void);
+
+/// Call before sending a command byte by byte with oi_byte_tx(), so the hazard watchdog doesn't send a stop in the middle of it.
+void oi_tx_begin(void);
+
+/// Call after the last byte of a command started with oi_tx_begin(). Sends a stop the watchdog held back meanwhile.
+void oi_tx_end(void);
+
 /// \brief Set the LEDS on the Create
 /// \param play_led 0=off, 1=on
 /// \param advance_led 0=off, 1=on
@@ -186,7 +269,7 @@ void oi_set_wheels(int16_t right_wheel, int16_t left_wheel);
 void oi_byte_tx(unsigned char value);
 
 /// \brief Receive a byte of data from the Create serial connection. Blocks 
-/// until a byte is received.
+/// until a byte is received. Don't use after oi_init(); the stream decoder owns the receiver.
 /// \return 8-bit value returned from the Create
 unsigned char oi_byte_rx(void);
 
@@ -202,7 +285,7 @@ void oi_load_song(int song_index, int num_notes, unsigned char  *notes, unsigned
 void oi_play_song(int index);
 
 /// Calls in built in demo to send the iRobot to an open home base
-/// This will cause the iRobot to enter the Passive state
+/// This will cause the iRobot to enter the Passive state. Returns at once; charging_state in the sensor frames shows when it has docked.
 void go_charge(void);
 
 #endif
\ No newline at end of file
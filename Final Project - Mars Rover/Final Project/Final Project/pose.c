@@ -0,0 +1,93 @@
+/*
+ * pose.c
+ *
+ * Odometry pose history. See pose.h.
+ */
+
+#include "calibration.h"
+#include "geometry.h"
+#include "util.h"
+#include "pose.h"
+
+static pose_sample history[POSE_HISTORY];
+static uint8_t newest;  // Index of the newest pose
+static uint8_t count;   // Poses in the history
+
+static void record(robot* bot, unsigned long time) {
+	newest = (newest + 1) & (POSE_HISTORY - 1);
+	history[newest].time = time;
+	history[newest].x = bot->x;
+	history[newest].y = bot->y;
+	history[newest].angle = bot->angle;
+	if (count < POSE_HISTORY)
+		count++;
+}
+
+void pose_reset(robot* bot) {
+	count = 0;
+	record(bot, uptime_ticks());
+}
+
+void pose_odometry(robot* bot, oi_t* self) {
+	if (self->distance == 0 && self->angle == 0)
+		return;
+
+	float distance = self->distance * 256.0 / cal_store.odo_distance_scale; // cm
+	float turned = self->angle * 1024.0 / cal_store.odo_angle_scale;        // degrees
+
+	int16_t sine, cosine;
+	geo_sincos(GEO_DEGREES(bot->angle + turned / 2), &sine, &cosine); // Along the heading in the middle of the turn
+	bot->x += distance * cosine / GEO_ONE; // Not geo_project(), which would round every frame's few mm away
+	bot->y += distance * sine / GEO_ONE;
+	bot->angle += turned;
+	if (bot->angle < 0) {
+		bot->angle += 360;
+	} else if (bot->angle >= 360) {
+		bot->angle -= 360;
+	}
+	bot->pose_changed = 1;
+
+	record(bot, oi_frame_time());
+}
+
+char pose_at(robot* bot, unsigned long time, pose_sample* pose) {
+	uint8_t i = newest;
+
+	if (count == 0 || (long) (time - history[newest].time) >= 0) { // Nothing newer than now
+		pose->time = time;
+		pose->x = bot->x;
+		pose->y = bot->y;
+		pose->angle = bot->angle;
+		return 1;
+	}
+
+	for (uint8_t n = 1; n < count; n++) {
+		uint8_t before = (i - 1) & (POSE_HISTORY - 1);
+
+		if ((long) (time - history[before].time) >= 0) { // Between before and i
+			pose_sample* a = &history[before];
+			pose_sample* b = &history[i];
+			float f = (float) (time - a->time) / (b->time - a->time);
+			float turned = b->angle - a->angle;
+
+			if (turned > 180) // Turned across 0 degrees
+				turned -= 360;
+			else if (turned < -180)
+				turned += 360;
+
+			pose->time = time;
+			pose->x = a->x + (b->x - a->x) * f;
+			pose->y = a->y + (b->y - a->y) * f;
+			pose->angle = a->angle + turned * f;
+			if (pose->angle < 0)
+				pose->angle += 360;
+			else if (pose->angle >= 360)
+				pose->angle -= 360;
+			return 1;
+		}
+		i = before;
+	}
+
+	*pose = history[i]; // Older than anything kept
+	return 0;
+}
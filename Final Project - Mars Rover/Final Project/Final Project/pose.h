@@ -0,0 +1,51 @@
+/*! \file pose.h
+    \brief Odometry pose with a short timestamped history.
+
+	The robot's pose is moved by every Create sensor frame the motion loops read, instead of by the
+	commanded distance and angle once a command is done. Each update is also kept in a ring of the
+	last POSE_HISTORY poses, timestamped with the time the frame arrived, so a sensor sample taken
+	while driving can be projected from the pose interpolated to the moment it was taken.
+*/
+
+#ifndef POSE_H
+#define POSE_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+#include "object_tracking.h"
+
+/*! \def POSE_HISTORY
+	\brief Poses kept. Must be a power of two. At one per 15 ms sensor frame this is about 120 ms, several times the age of the oldest sample the look-ahead places.
+*/
+#define POSE_HISTORY 8
+
+//! Where the robot was at some time.
+typedef struct {
+	unsigned long time; /*!< uptime_ticks() */
+	float x;            /*!< cm */
+	float y;            /*!< cm */
+	float angle;        /*!< degrees, 0 to 360 */
+} pose_sample;
+
+/// Forgets the history and starts it again from the robot's current pose.
+void pose_reset(robot* bot);
+
+/// Moves the robot by the odometry in a sensor frame.
+/**
+* The distance is taken along the heading halfway through the frame's turn. Both are corrected with the calibration store.
+* @param bot the pose to move
+* @param self a frame just read with oi_update()
+*/
+void pose_odometry(robot* bot, oi_t* self);
+
+/// Pose of the robot at a given time.
+/**
+* Interpolated between the two poses around that time. Times after the newest pose give the current pose.
+* @param bot the current pose
+* @param time uptime_ticks() at the moment wanted
+* @param pose set to the pose at that time
+* @return 1, or 0 if the time is older than the history and the oldest pose was used
+*/
+char pose_at(robot* bot, unsigned long time, pose_sample* pose);
+
+#endif
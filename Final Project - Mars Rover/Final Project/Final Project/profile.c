@@ -0,0 +1,66 @@
+/*
+ * profile.c
+ *
+ * Hot path profiler. See profile.h.
+ */
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#include "util.h"
+#include "profile.h"
+
+#ifndef NPROFILE
+
+prof_probe prof_table[PROF_PROBES];
+
+static const char prof_names[PROF_PROBES][19] PROGMEM = {"oi_update", "read_IR_distance", "read_PING_distance", "find_objs_IR", "update_information", "send_message"};
+
+void prof_end(unsigned char id, unsigned long now) {
+	prof_probe* p = &prof_table[id];
+	unsigned long elapsed = now - p->start; // Unsigned subtraction handles the uptime wrapping once
+	
+	if (p->count == 0 || elapsed < p->min)
+		p->min = elapsed;
+	if (elapsed > p->max)
+		p->max = elapsed;
+	p->total += elapsed;
+	p->count++;
+}
+
+void prof_reset(void) {
+	for (int i = 0; i < PROF_PROBES; i++) {
+		prof_table[i].count = 0;
+		prof_table[i].total = 0;
+		prof_table[i].min = 0;
+		prof_table[i].max = 0;
+	}
+}
+
+void prof_report(void) {
+	char buffer[100];
+	char name[19];
+	prof_probe copy[PROF_PROBES];
+	
+	for (int i = 0; i < PROF_PROBES; i++) // send_message() is itself probed, so report a snapshot
+		copy[i] = prof_table[i];
+	
+	send_message_P(PSTR("\r\nProbe               Count   Total (us)  Min (us)  Max (us)\r\n"));
+	for (int i = 0; i < PROF_PROBES; i++) {
+		strcpy_P(name, prof_names[i]);
+		sprintf_P(buffer, PSTR("%-18s %6u %12lu %9lu %9lu\r\n"), name, copy[i].count, copy[i].total * PROF_US_PER_TICK, copy[i].min * PROF_US_PER_TICK, copy[i].max * PROF_US_PER_TICK);
+		send_message(buffer);
+	}
+	
+	prof_reset();
+}
+
+#else
+
+void prof_reset(void) {
+}
+
+void prof_report(void) {
+	send_message_P(PSTR("\r\nProfiler compiled out (NPROFILE)\r\n"));
+}
+
+#endif
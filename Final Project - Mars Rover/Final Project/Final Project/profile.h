@@ -0,0 +1,87 @@
+/*! \file profile.h
+    \brief Hot path profiler.
+	
+	Wrap code in PROF_BEGIN(id) and PROF_END(id) to accumulate how many times it ran and the total,
+	shortest, and longest time it took. Time comes from uptime_ticks(), the 32-bit count of Timer1,
+	which the PING sensor leaves free running with a prescaler of 64, so one tick is 64 cycles (4 us)
+	and a single measurement can be up to 4.7 hours. Define NPROFILE (the Release configuration does)
+	to compile every probe out.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "util.h"
+
+/*! \def PROF_OI_UPDATE
+	\brief Probe around oi_update()
+*/
+#define PROF_OI_UPDATE 0
+
+/*! \def PROF_READ_IR
+	\brief Probe around read_IR_distance_mm()
+*/
+#define PROF_READ_IR 1
+
+/*! \def PROF_READ_PING
+	\brief Probe around read_PING_distance()
+*/
+#define PROF_READ_PING 2
+
+/*! \def PROF_FIND_OBJS
+	\brief Probe around find_objs_IR()
+*/
+#define PROF_FIND_OBJS 3
+
+/*! \def PROF_UPDATE_INFO
+	\brief Probe around update_information()
+*/
+#define PROF_UPDATE_INFO 4
+
+/*! \def PROF_SEND_MESSAGE
+	\brief Probe around send_message()
+*/
+#define PROF_SEND_MESSAGE 5
+
+/*! \def PROF_PROBES
+	\brief Number of probes
+*/
+#define PROF_PROBES 6
+
+/*! \def PROF_US_PER_TICK
+	\brief Microseconds per Timer1 tick (64 cycles at 16 MHz)
+*/
+#define PROF_US_PER_TICK 4
+
+typedef struct {
+	unsigned int count;  /*!< Times the probe finished */
+	unsigned long total; /*!< Sum of every measurement in ticks */
+	unsigned long min;   /*!< Shortest measurement in ticks */
+	unsigned long max;   /*!< Longest measurement in ticks */
+	unsigned long start; /*!< uptime_ticks() at the last PROF_BEGIN */
+} prof_probe;
+
+#ifndef NPROFILE
+
+extern prof_probe prof_table[PROF_PROBES];
+
+/// Adds the time since the probe's PROF_BEGIN to its totals.
+void prof_end(unsigned char id, unsigned long now);
+
+#define PROF_BEGIN(id) (prof_table[id].start = uptime_ticks())
+#define PROF_END(id) prof_end(id, uptime_ticks())
+
+#else
+
+#define PROF_BEGIN(id) ((void) 0)
+#define PROF_END(id) ((void) 0)
+
+#endif
+
+/// Sends every probe's count, total, min, and max (in microseconds) over bluetooth, then clears the table.
+void prof_report(void);
+
+/// Clears every probe.
+void prof_reset(void);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * recorder.c
+ *
+ * Flight recorder. See recorder.h.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdio.h>
+#include "util.h"
+#include "idle.h"
+#include "recorder.h"
+
+typedef struct {
+	uint16_t magic;
+	uint16_t count; // Events ever saved. The next one goes in slot count % REC_EEPROM_EVENTS.
+	rec_event events[REC_EEPROM_EVENTS];
+} rec_image;
+
+rec_image EEMEM rec_eeprom;
+
+static rec_event rec_ring[REC_RAM_EVENTS];
+static volatile uint16_t rec_written; // Events ever logged
+static volatile uint16_t rec_saved;   // Events ever copied to EEPROM
+static volatile uint16_t rec_target;  // Flush stops once rec_saved gets here
+static volatile uint16_t rec_count;   // Copy of rec_eeprom.count
+static volatile uint8_t rec_byte;     // Next byte of the event being saved; past the event are the two count bytes
+static volatile uint8_t rec_flushing;
+static uint16_t rec_dropped;
+static uint8_t rec_oi_calls;
+
+void rec_init(void) {
+	rec_idle();
+	if (eeprom_read_word(&rec_eeprom.magic) == REC_MAGIC) {
+		rec_count = eeprom_read_word(&rec_eeprom.count);
+	} else {
+		rec_count = 0;
+		eeprom_update_word(&rec_eeprom.count, 0);
+		eeprom_update_word(&rec_eeprom.magic, REC_MAGIC);
+	}
+	
+	rec_log(REC_BOOT, 0, MCUCSR, 0);
+	MCUCSR = 0;
+}
+
+void rec_log(uint8_t type, uint8_t arg, int16_t a, int16_t b) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if ((uint16_t) (rec_written - rec_saved) >= REC_RAM_EVENTS) { // Ring is full
+			rec_dropped++;
+			if (rec_flushing) // Oldest event is being saved right now, so drop this one instead
+				return;
+			rec_saved++;
+		}
+		
+		rec_event* e = &rec_ring[rec_written & (REC_RAM_EVENTS - 1)];
+		e->type = type;
+		e->arg = arg;
+		e->time = uptime_ticks() >> REC_TIME_SHIFT;
+		e->a = a;
+		e->b = b;
+		rec_written++;
+	}
+}
+
+void rec_oi(oi_t* self) {
+	if (++rec_oi_calls < REC_OI_DECIMATE)
+		return;
+	rec_oi_calls = 0;
+	
+	uint8_t flags = self->bumper_right | (self->bumper_left << 1) | ((self->cliff_left != 0) << 2) | ((self->cliff_frontleft != 0) << 3) | ((self->cliff_frontright != 0) << 4) | ((self->cliff_right != 0) << 5) | ((self->wheeldrop_left | self->wheeldrop_right | self->wheeldrop_caster) << 6);
+	rec_log(REC_OI, flags, self->distance, self->angle);
+}
+
+void rec_flush(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		rec_target = rec_written;
+		if (!rec_flushing && rec_saved != rec_target) {
+			rec_flushing = 1;
+			rec_byte = 0;
+			EECR |= (1 << EERIE); // Fires as soon as the EEPROM is ready
+		}
+	}
+}
+
+/* EEPROM is ready for the next byte */
+ISR(EE_READY_vect)
+{
+	uint8_t* address;
+	uint8_t data;
+	
+	if (rec_byte < sizeof(rec_event)) { // Event bytes
+		address = (uint8_t*) &rec_eeprom.events[rec_count % REC_EEPROM_EVENTS] + rec_byte;
+		data = ((uint8_t*) &rec_ring[rec_saved & (REC_RAM_EVENTS - 1)])[rec_byte];
+	} else { // Then the new count, so a reset never leaves a half written event in the log
+		address = (uint8_t*) &rec_eeprom.count + (rec_byte - sizeof(rec_event));
+		data = (rec_byte == sizeof(rec_event)) ? (rec_count + 1) : ((rec_count + 1) >> 8);
+	}
+	
+	EEAR = (uintptr_t) address;
+	EEDR = data;
+	EECR |= (1 << EEMWE);
+	EECR |= (1 << EEWE);
+	
+	if (++rec_byte == sizeof(rec_event) + 2) { // Event saved
+		rec_byte = 0;
+		rec_count++;
+		rec_saved++;
+		if (rec_saved == rec_target) {
+			rec_flushing = 0;
+			EECR &= ~(1 << EERIE);
+		}
+	}
+}
+
+void rec_idle(void) {
+	cli();
+	while (rec_flushing) // The EEPROM ready interrupt wakes it
+		idle_sleep();
+	sei();
+}
+
+void rec_download(void) {
+	char buffer[50];
+	rec_event e;
+	
+	rec_idle(); // EEPROM can't be read while the flush is writing it
+	
+	uint16_t count = rec_count;
+	uint16_t n = (count < REC_EEPROM_EVENTS) ? count : REC_EEPROM_EVENTS;
+	
+	sprintf_P(buffer, PSTR("\r\nFlight recorder: %u events, %u dropped\r\n"), n, rec_dropped);
+	send_message(buffer);
+	
+	for (uint16_t i = count - n; i != count; i++) {
+		eeprom_read_block(&e, &rec_eeprom.events[i % REC_EEPROM_EVENTS], sizeof(rec_event));
+		sprintf_P(buffer, PSTR("R,%u,%u,%u,%d,%d\r\n"), e.time, e.type, e.arg, e.a, e.b);
+		send_message(buffer);
+	}
+}
@@ -0,0 +1,110 @@
+/*! \file recorder.h
+    \brief Flight recorder.
+	
+	Events are timestamped and kept in a small ring buffer in SRAM. rec_flush() copies them into a
+	larger ring in EEPROM one byte per EEPROM ready interrupt, so a flush never blocks the robot,
+	and the EEPROM keeps the last REC_EEPROM_EVENTS events across resets. rec_download() sends them
+	back as one "R,time,type,arg,a,b" line per event for the host replay tool.
+*/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+
+/*! \def REC_RAM_EVENTS
+	\brief Events buffered in SRAM. Must be a power of two.
+*/
+#define REC_RAM_EVENTS 32
+
+/*! \def REC_EEPROM_EVENTS
+	\brief Events kept in EEPROM
+*/
+#define REC_EEPROM_EVENTS 128
+
+/*! \def REC_OI_DECIMATE
+	\brief Only every this many oi_update() calls is recorded
+*/
+#define REC_OI_DECIMATE 8
+
+/*! \def REC_MAGIC
+	\brief Marks the EEPROM log as written by this firmware
+*/
+#define REC_MAGIC 0x4652
+
+/*! \def REC_TIME_SHIFT
+	\brief Event time is uptime_ticks() >> REC_TIME_SHIFT, 16.384 ms per unit
+*/
+#define REC_TIME_SHIFT 12
+
+/*! \def REC_BOOT
+	\brief Robot started. a = reset cause (MCUCSR)
+*/
+#define REC_BOOT 0
+
+/*! \def REC_COMMAND
+	\brief Command received. arg = command, a = travel distance, b = angle to turn
+*/
+#define REC_COMMAND 1
+
+/*! \def REC_HAZARD
+	\brief Hazard logged by log_position(). arg = (side << 4) | (type - CLIFF) / 5, a = robot x, b = robot y
+*/
+#define REC_HAZARD 2
+
+/*! \def REC_OI
+	\brief Create sensor snapshot. arg = bumper and cliff flags (see rec_oi()), a = distance, b = angle
+*/
+#define REC_OI 3
+
+/*! \def REC_SCAN
+	\brief Sweep finished. arg = objects found, a = objects tracked, b = robot angle
+*/
+#define REC_SCAN 4
+
+/*! \def REC_STOP
+	\brief Hazard watchdog stopped a move or turn with nothing logged for it. arg = OI_HAZARD_ bits, a = robot x, b = robot y
+*/
+#define REC_STOP 5
+
+typedef struct {
+	uint8_t type;  /*!< One of the REC_ event types */
+	uint8_t arg;   /*!< Event specific byte */
+	uint16_t time; /*!< Uptime in 16.384 ms units */
+	int16_t a;     /*!< Event specific value */
+	int16_t b;     /*!< Event specific value */
+} rec_event;
+
+/// Reads the EEPROM log position and records a REC_BOOT event.
+void rec_init(void);
+
+/// Records an event in the SRAM ring.
+/**
+* Takes a few microseconds. If the ring is full the oldest unsaved event is dropped, or the new one if a flush is saving the oldest.
+* @param type one of the REC_ event types
+* @param arg event specific byte
+* @param a event specific value
+* @param b event specific value
+*/
+void rec_log(uint8_t type, uint8_t arg, int16_t a, int16_t b);
+
+/// Records a REC_OI snapshot of every REC_OI_DECIMATE th call.
+/**
+* Flags: bit 0 bumper right, 1 bumper left, 2 cliff left, 3 cliff front left, 4 cliff front right, 5 cliff right, 6 any wheel drop.
+*/
+void rec_oi(oi_t* self);
+
+/// Starts copying the unsaved events to EEPROM in the background.
+void rec_flush(void);
+
+/// Sleeps until any flush has finished.
+/**
+* The flush writes the EEPROM from its interrupt, which would corrupt an avr-libc eeprom_* call it lands in the middle of. Anything else that touches the EEPROM calls this first; only rec_flush() starts a flush again.
+*/
+void rec_idle(void);
+
+/// Waits for any flush to finish with rec_idle(), then sends every event in EEPROM over bluetooth, oldest first.
+void rec_download(void);
+
+#endif
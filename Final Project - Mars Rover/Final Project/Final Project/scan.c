@@ -0,0 +1,234 @@
+/*
+ * scan.c
+ *
+ * Sweep buffer and object segmentation. See scan.h.
+ */
+
+#include <avr/pgmspace.h>
+#include "util.h"
+#include "sensor_fusion.h"
+#include "compress.h"
+#include "object_tracking.h"
+#include "scan.h"
+
+scan_sample scan_data[SCAN_SAMPLES];
+
+/* tan(k / 2 degrees) in Q12 for k = 0 to 90 */
+static const uint16_t tan_half_degree[91] PROGMEM = {
+	0, 36, 71, 107, 143, 179, 215, 251, 286, 322,
+	358, 394, 431, 467, 503, 539, 576, 612, 649, 685,
+	722, 759, 796, 833, 871, 908, 946, 983, 1021, 1059,
+	1098, 1136, 1175, 1213, 1252, 1291, 1331, 1371, 1410, 1450,
+	1491, 1531, 1572, 1613, 1655, 1697, 1739, 1781, 1824, 1867,
+	1910, 1954, 1998, 2042, 2087, 2132, 2178, 2224, 2270, 2317,
+	2365, 2413, 2461, 2510, 2559, 2609, 2660, 2711, 2763, 2815,
+	2868, 2922, 2976, 3031, 3087, 3143, 3200, 3258, 3317, 3376,
+	3437, 3498, 3561, 3624, 3688, 3753, 3820, 3887, 3955, 4025,
+	4096
+};
+
+/* Running sums for the object being segmented */
+typedef struct {
+	uint8_t start;
+	uint32_t weighted; // Sum of distance * confidence
+	uint16_t confidence; // Sum of confidence
+} segment_sums;
+
+uint16_t scan_sonar_cm(uint16_t ticks) {
+	return ((uint32_t) ticks * 686) / 10000; // 4 us per tick * 34300 cm/s / 2
+}
+
+uint8_t linear_width_cm(uint16_t distance, uint8_t angular_width) {
+	if (angular_width > 90)
+		angular_width = 90;
+	
+	uint32_t width = ((uint32_t) 2 * distance * pgm_read_word(&tan_half_degree[angular_width])) >> 12;
+	
+	return (width > 255) ? 255 : width;
+}
+
+/* Stores an object if it is big enough. Returns the new number of objects. */
+static uint8_t close_segment(scan_segment* segments, uint8_t count, uint8_t max_segments, segment_sums* sums, uint8_t end) {
+	if (count >= max_segments || end + 1 - sums->start < SCAN_MIN_SAMPLES || sums->confidence == 0)
+		return count;
+	
+	scan_segment* seg = &segments[count];
+	seg->start = sums->start;
+	seg->end = end;
+	seg->distance = sums->weighted / sums->confidence;
+	seg->angular_width = end - sums->start;
+	seg->linear_width = linear_width_cm(seg->distance, seg->angular_width);
+	
+	return count + 1;
+}
+
+uint8_t scan_segment_objects(scan_segment* segments, uint8_t max_segments) {
+	uint8_t count = 0;
+	uint8_t open = 0; // Are we inside an object?
+	uint8_t gap = 0; // Samples missed since the last sample on the object
+	uint8_t last_near = 0; // Last sample on the object
+	int last_distance = 0;
+	
+	segment_sums sums = {0, 0, 0}; // The whole object so far
+	segment_sums after_peak = {0, 0, 0}; // Just the samples after the highest range seen since the lowest
+	int min_distance = 0, peak_distance = 0;
+	uint8_t peak = 0;
+	
+	for (uint8_t i = 0; i < SCAN_SAMPLES; i++) {
+		int distance;
+		uint8_t confidence = fuse_range(scan_data[i].ir_cm, scan_sonar_cm(scan_data[i].sonar_ticks), &distance);
+		
+		if (confidence == 0 || distance > MAX_DETECTION_DISTANCE) { // Nothing here
+			if (open && ++gap > SCAN_MAX_GAP) {
+				count = close_segment(segments, count, max_segments, &sums, last_near);
+				open = 0;
+			}
+			continue;
+		}
+		
+		uint8_t started = 0; // Did an object start at this sample?
+		
+		if (open) {
+			int jump = distance - last_distance;
+			if (jump < 0)
+				jump = -jump;
+			
+			if (jump > SCAN_EDGE_JUMP + last_distance / 8) { // Range edge. A different object starts here.
+				count = close_segment(segments, count, max_segments, &sums, last_near);
+				open = 0;
+			} else if (peak_distance - min_distance >= SCAN_SPLIT_DEPTH && peak_distance - distance >= SCAN_SPLIT_DEPTH && peak > sums.start) {
+				// Range went down, up, and down again. Two objects are touching; split at the peak.
+				sums.weighted -= after_peak.weighted;
+				sums.confidence -= after_peak.confidence;
+				count = close_segment(segments, count, max_segments, &sums, peak);
+				sums.start = peak + 1;
+				sums.weighted = after_peak.weighted;
+				sums.confidence = after_peak.confidence;
+				started = 1;
+			}
+		}
+		
+		if (!open) { // Start a new object
+			open = 1;
+			sums.start = i;
+			sums.weighted = 0;
+			sums.confidence = 0;
+			started = 1;
+		}
+		
+		/* Track the lowest range and the highest range after it */
+		if (started || distance < min_distance) {
+			min_distance = distance;
+			peak_distance = distance;
+			peak = i;
+			after_peak.weighted = 0;
+			after_peak.confidence = 0;
+		} else if (distance > peak_distance) {
+			peak_distance = distance;
+			peak = i;
+			after_peak.weighted = 0;
+			after_peak.confidence = 0;
+		} else {
+			after_peak.weighted += (uint32_t) distance * confidence;
+			after_peak.confidence += confidence;
+		}
+		
+		sums.weighted += (uint32_t) distance * confidence;
+		sums.confidence += confidence;
+		last_distance = distance;
+		last_near = i;
+		gap = 0;
+	}
+	
+	if (open)
+		count = close_segment(segments, count, max_segments, &sums, last_near);
+	
+	return count;
+}
+
+/* Sends a byte of a frame and adds it to the checksum */
+static void frame_byte(uint8_t data, uint8_t* sum) {
+	USART_Transmit(data);
+	*sum += data;
+}
+
+/* Sends or just counts one delta encoded value. Returns the bytes it takes. */
+static uint8_t frame_delta(uint16_t value, uint16_t previous, uint8_t send, uint8_t* sum) {
+	int16_t delta = value - previous;
+	
+	if (delta >= -127 && delta <= 127) {
+		if (send)
+			frame_byte(delta, sum);
+		return 1;
+	}
+	
+	if (send) {
+		frame_byte(SCAN_DELTA_ESCAPE, sum);
+		frame_byte(value, sum);
+		frame_byte(value >> 8, sum);
+	}
+	return 3;
+}
+
+/* comp_sink that sends a byte of a frame */
+static void frame_sink(uint8_t data, void* context) {
+	frame_byte(data, context);
+}
+
+/* comp_sink that only counts */
+static void count_sink(uint8_t data, void* context) {
+	(void) data;
+	(*(uint16_t*) context)++;
+}
+
+/* Sends or just counts the payload. Returns its length. */
+static uint16_t frame_payload(uint8_t flags, uint8_t send, uint8_t* sum) {
+	uint16_t length = 0;
+	
+	if (flags & SCAN_FRAME_PACKED) {
+		comp_series s;
+		
+		comp_series_begin(&s, send ? frame_sink : count_sink, send ? (void*) sum : (void*) &length);
+		for (int i = 0; i < SCAN_SAMPLES; i++)
+			comp_series_put(&s, scan_data[i].ir_cm * 10);
+		comp_series_end(&s);
+		
+		comp_series_begin(&s, send ? frame_sink : count_sink, send ? (void*) sum : (void*) &length);
+		for (int i = 0; i < SCAN_SAMPLES; i++)
+			comp_series_put(&s, scan_data[i].sonar_ticks);
+		comp_series_end(&s);
+		
+		return length;
+	}
+	
+	for (int i = 0; i < SCAN_SAMPLES; i++) {
+		if (i == 0 || !(flags & SCAN_FRAME_DELTA)) {
+			if (send) {
+				frame_byte(scan_data[i].ir_cm * 10, sum);
+				frame_byte((scan_data[i].ir_cm * 10) >> 8, sum);
+				frame_byte(scan_data[i].sonar_ticks, sum);
+				frame_byte(scan_data[i].sonar_ticks >> 8, sum);
+			}
+			length += 4;
+		} else {
+			length += frame_delta(scan_data[i].ir_cm * 10, scan_data[i - 1].ir_cm * 10, send, sum);
+			length += frame_delta(scan_data[i].sonar_ticks, scan_data[i - 1].sonar_ticks, send, sum);
+		}
+	}
+	
+	return length;
+}
+
+void scan_send_bulk(uint8_t flags) {
+	uint8_t sum = 0;
+	uint16_t length = frame_payload(flags, 0, &sum); // Length goes before the payload, so count it first
+	
+	USART_Transmit(SCAN_FRAME_SYNC1);
+	USART_Transmit(SCAN_FRAME_SYNC2);
+	frame_byte(flags, &sum);
+	frame_byte(SCAN_SAMPLES, &sum);
+	frame_byte(length, &sum);
+	frame_byte(length >> 8, &sum);
+	frame_payload(flags, 1, &sum);
+	USART_Transmit(-sum);
+}
@@ -0,0 +1,119 @@
+/*! \file scan.h
+    \brief Buffer for one complete 181 sample sweep and the object segmentation pass that runs over it.
+	
+	Segmentation looks at the whole scan instead of one sample at a time. It splits objects on
+	jumps in range and on the range peak between two round objects standing side by side, and
+	bridges single sample dropouts. Everything is done in integer math in one pass over the samples.
+*/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <inttypes.h>
+
+/*! \def SCAN_SAMPLES
+	\brief Number of samples in a sweep (one per degree, 0 to 180)
+*/
+#define SCAN_SAMPLES 181
+/*! \def SCAN_MAX_SEGMENTS
+	\brief Maximum number of objects found in one sweep
+*/
+#define SCAN_MAX_SEGMENTS 16
+/*! \def SCAN_MIN_SAMPLES
+	\brief An object must cover at least this many samples to be kept
+*/
+#define SCAN_MIN_SAMPLES 3
+/*! \def SCAN_MAX_GAP
+	\brief Number of missing samples bridged inside one object
+*/
+#define SCAN_MAX_GAP 1
+/*! \def SCAN_EDGE_JUMP
+	\brief Change in range (in cm) between neighboring samples that marks an edge, on top of 1/8 of the range
+*/
+#define SCAN_EDGE_JUMP 4
+/*! \def SCAN_SPLIT_DEPTH
+	\brief Rise and fall in range (in cm) around a peak that splits two touching objects
+*/
+#define SCAN_SPLIT_DEPTH 3
+/*! \def SCAN_FRAME_SYNC1
+	\brief First byte of a bulk scan frame
+*/
+#define SCAN_FRAME_SYNC1 0xA5
+/*! \def SCAN_FRAME_SYNC2
+	\brief Second byte of a bulk scan frame
+*/
+#define SCAN_FRAME_SYNC2 0x5A
+/*! \def SCAN_FRAME_DELTA
+	\brief Flag set when the frame payload is delta encoded
+*/
+#define SCAN_FRAME_DELTA 0x01
+/*! \def SCAN_FRAME_PACKED
+	\brief Flag set when the frame payload is compressed with comp_series (see compress.h)
+*/
+#define SCAN_FRAME_PACKED 0x02
+/*! \def SCAN_DELTA_ESCAPE
+	\brief Delta byte meaning the next two bytes are the full value
+*/
+#define SCAN_DELTA_ESCAPE 0x80
+
+/*! \def SCAN_IR_MAX
+	\brief Farthest IR distance a sample holds, in cm. The IR sensor isn't trusted past 60 cm anyway.
+*/
+#define SCAN_IR_MAX 255
+
+//! One raw sample of a sweep. Three bytes, so the whole sweep fits in 543 bytes of SRAM.
+typedef struct {
+	uint8_t ir_cm; /*!< Distance measured by the IR sensor in cm, up to SCAN_IR_MAX. */
+	uint16_t sonar_ticks; /*!< SONAR echo time in timer 1 ticks (4 us each). */
+} scan_sample;
+
+//! An object found by scan_segment_objects().
+typedef struct {
+	uint8_t start; /*!< First angle (in degrees) the object was seen at. */
+	uint8_t end; /*!< Last angle (in degrees) the object was seen at. */
+	uint16_t distance; /*!< Confidence weighted average fused distance (in cm). */
+	uint8_t angular_width; /*!< end - start (in degrees). */
+	uint8_t linear_width; /*!< Width (in cm) computed from distance and angular_width. */
+} scan_segment;
+
+/// Samples of the most recent sweep, indexed by servo angle.
+extern scan_sample scan_data[SCAN_SAMPLES];
+
+/// Converts a SONAR echo time to a distance.
+/**
+* @param ticks echo time in timer 1 ticks
+* @return distance in cm
+*/
+uint16_t scan_sonar_cm(uint16_t ticks);
+
+/// Computes the linear width of an object.
+/**
+* 2 * distance * tan(angular_width / 2) using a lookup table. Widths beyond 90 degrees are treated as 90 degrees.
+* @param distance distance to the object in cm
+* @param angular_width angular width of the object in degrees
+* @return linear width in cm
+*/
+uint8_t linear_width_cm(uint16_t distance, uint8_t angular_width);
+
+/// Finds the objects in scan_data.
+/**
+* Fuses the IR and SONAR readings of each sample, then splits the scan into objects at range edges and range peaks. O(SCAN_SAMPLES), no floating point.
+* @param segments array that receives the objects found
+* @param max_segments size of segments
+* @return the number of objects found
+*/
+uint8_t scan_segment_objects(scan_segment* segments, uint8_t max_segments);
+
+/// Sends all of scan_data over bluetooth as one frame.
+/**
+* Frame: SCAN_FRAME_SYNC1, SCAN_FRAME_SYNC2, flags, sample count, payload length (2 bytes), payload, checksum.
+* Multi-byte values are little endian. The checksum makes the bytes from flags through checksum add up to 0.
+* The raw payload is the IR distance in mm (ir_cm * 10) and sonar_ticks for every sample. The delta payload starts
+* with the first sample raw, then for each following sample the change in IR mm and in sonar_ticks as one signed byte
+* each, or SCAN_DELTA_ESCAPE followed by the full value when the change doesn't fit. The packed payload is every IR mm
+* as one comp_series, then every sonar_ticks as another.
+* @param flags SCAN_FRAME_PACKED to compress, SCAN_FRAME_DELTA to delta encode, 0 to send raw
+*/
+void scan_send_bulk(uint8_t flags);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * script.c
+ *
+ * Create on-board scripts. See script.h.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "util.h"
+#include "script.h"
+
+static uint8_t marker = SCRIPT_SONG_B; // Marker song of the script playing, or of the last one
+static unsigned long started;           // uptime_ticks() when it was played
+static unsigned long timeout;           // Ticks it may run, 0 for no limit
+
+void script_init(void) {
+	unsigned char note = 0; // Outside the 31 to 127 note range, so it plays as a rest
+	unsigned char duration = 1; // 1/64 s
+
+	oi_load_song(SCRIPT_SONG_A, 1, &note, &duration);
+	oi_load_song(SCRIPT_SONG_B, 1, &note, &duration);
+}
+
+void script_begin(oi_script* s) {
+	s->length = 0;
+	s->duration = 0;
+	s->open_ended = 0;
+}
+
+static void put_word(oi_script* s, int16_t value) {
+	s->bytes[s->length++] = value >> 8;
+	s->bytes[s->length++] = value & 0xff;
+}
+
+static void put_wheels(oi_script* s, int16_t right_wheel, int16_t left_wheel) {
+	s->bytes[s->length++] = OI_OPCODE_DRIVE_WHEELS;
+	put_word(s, right_wheel);
+	put_word(s, left_wheel);
+}
+
+/* Is there room for a step of this size and the ending script_play() adds? */
+static char fits(oi_script* s, uint8_t size) {
+	return s->length + size + SCRIPT_END_SIZE <= SCRIPT_MAX;
+}
+
+static int16_t wheel_speed(int16_t velocity) {
+	velocity = abs(velocity);
+	if (velocity < 1)
+		velocity = 1;
+	if (velocity > 500)
+		velocity = 500;
+	return velocity;
+}
+
+char script_drive(oi_script* s, int16_t velocity, int16_t distance) {
+	if (!fits(s, 8))
+		return 0;
+
+	velocity = wheel_speed(velocity);
+	s->duration += labs(distance) * 1000L / velocity;
+	if (distance < 0)
+		velocity = -velocity;
+
+	put_wheels(s, velocity, velocity);
+	s->bytes[s->length++] = OI_OPCODE_WAIT_DISTANCE;
+	put_word(s, distance);
+	return 1;
+}
+
+char script_turn(oi_script* s, int16_t velocity, int16_t degrees) {
+	if (!fits(s, 8))
+		return 0;
+
+	velocity = wheel_speed(velocity);
+	s->duration += labs((long) degrees) * M_PI * SCRIPT_WHEEL_BASE / 360.0 * 1000.0 / velocity; // Each wheel travels its share of the circle
+	if (degrees < 0)
+		velocity = -velocity;
+
+	put_wheels(s, velocity, -velocity); // Right wheel forward turns counterclockwise
+	s->bytes[s->length++] = OI_OPCODE_WAIT_ANGLE;
+	put_word(s, degrees);
+	return 1;
+}
+
+char script_wait_time(oi_script* s, uint8_t tenths) {
+	if (!fits(s, 7))
+		return 0;
+
+	s->duration += tenths * 100L;
+	put_wheels(s, 0, 0);
+	s->bytes[s->length++] = OI_OPCODE_WAIT_TIME;
+	s->bytes[s->length++] = tenths;
+	return 1;
+}
+
+char script_wait_event(oi_script* s, int8_t event) {
+	if (!fits(s, 2))
+		return 0;
+
+	s->open_ended = 1;
+	s->bytes[s->length++] = OI_OPCODE_WAIT_EVENT;
+	s->bytes[s->length++] = event;
+	return 1;
+}
+
+void script_play(oi_script* s) {
+	uint8_t i;
+
+	marker = (marker == SCRIPT_SONG_A) ? SCRIPT_SONG_B : SCRIPT_SONG_A;
+
+	oi_tx_begin();
+	oi_byte_tx(OI_OPCODE_SCRIPT);
+	oi_byte_tx(s->length + SCRIPT_END_SIZE);
+	for (i = 0; i < s->length; i++)
+		oi_byte_tx(s->bytes[i]);
+
+	// Ending: stop, back to Full mode, and the marker that says it got here
+	oi_byte_tx(OI_OPCODE_DRIVE_WHEELS);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	oi_byte_tx(0);
+	oi_byte_tx(OI_OPCODE_FULL);
+	oi_byte_tx(OI_OPCODE_PLAY);
+	oi_byte_tx(marker);
+
+	oi_byte_tx(OI_OPCODE_SAFE); // The Create stops itself on cliffs and wheel drops while the script runs
+	oi_byte_tx(OI_OPCODE_PLAY_SCRIPT);
+	oi_tx_end();
+
+	started = uptime_ticks();
+	timeout = s->open_ended ? 0 : (s->duration + SCRIPT_SLACK) * 250; // 250 ticks per ms
+}
+
+uint8_t script_poll(const oi_t* self) {
+	if (self->song_number == marker && self->oi_mode == OI_MODE_FULL)
+		return SCRIPT_DONE;
+
+	if (self->oi_mode == OI_MODE_PASSIVE) { // Safe mode tripped and ended the script
+		oi_tx_begin();
+		oi_byte_tx(OI_OPCODE_FULL);
+		oi_tx_end();
+		return SCRIPT_ABORTED;
+	}
+
+	if (timeout && uptime_ticks() - started > timeout) {
+		oi_set_wheels(0, 0); // Only heard if the Create is not in the middle of a wait
+		return SCRIPT_TIMEOUT;
+	}
+
+	return SCRIPT_RUNNING;
+}
@@ -0,0 +1,145 @@
+/*! \file script.h
+    \brief Motions the Create runs on its own from an uploaded script.
+
+	A script is built from drive, turn, and wait steps, uploaded with OI_OPCODE_SCRIPT, and played
+	with OI_OPCODE_PLAY_SCRIPT. The Create then ends each step on its own distance and angle waits,
+	so the ATmega128 only has to call script_poll() with each sensor frame and is free to scan or
+	talk to the operator in between.
+
+	The Create ignores serial commands while it is waiting, so the hazard watchdog can't stop a
+	script. Scripts are played in Safe mode instead: the Create stops itself and drops to Passive
+	on a cliff or wheel drop. Bumps don't stop a script unless it waits for SCRIPT_EVENT_BUMP.
+
+	Every script ends by stopping the wheels, going back to Full mode, and playing one of two
+	silent marker songs. The song number in the sensor stream changes to the marker when the script
+	is done.
+*/
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+
+/*! \def SCRIPT_MAX
+	\brief Longest script the Create stores, in bytes
+*/
+#define SCRIPT_MAX 100
+/*! \def SCRIPT_END_SIZE
+	\brief Bytes script_play() adds at the end: stop, Full mode, and the marker song
+*/
+#define SCRIPT_END_SIZE 8
+/*! \def SCRIPT_SONG_A
+	\brief First marker song slot. Scripts take turns between the two, so a finished script is never mistaken for the previous one.
+*/
+#define SCRIPT_SONG_A 14
+/*! \def SCRIPT_SONG_B
+	\brief Second marker song slot
+*/
+#define SCRIPT_SONG_B 15
+/*! \def SCRIPT_WHEEL_BASE
+	\brief Distance between the wheels in mm, used to guess how long a turn takes
+*/
+#define SCRIPT_WHEEL_BASE 258
+/*! \def SCRIPT_SLACK
+	\brief Extra time in ms a script gets over its expected run time before script_poll() gives up on it
+*/
+#define SCRIPT_SLACK 2000
+
+/*! \def SCRIPT_EVENT_WHEEL_DROP
+	\brief OI_OPCODE_WAIT_EVENT code for any wheel drop. Negative codes wait for the event to end.
+*/
+#define SCRIPT_EVENT_WHEEL_DROP 1
+/*! \def SCRIPT_EVENT_BUMP
+	\brief OI_OPCODE_WAIT_EVENT code for either bumper
+*/
+#define SCRIPT_EVENT_BUMP 5
+/*! \def SCRIPT_EVENT_VIRTUAL_WALL
+	\brief OI_OPCODE_WAIT_EVENT code for a virtual wall
+*/
+#define SCRIPT_EVENT_VIRTUAL_WALL 8
+/*! \def SCRIPT_EVENT_WALL
+	\brief OI_OPCODE_WAIT_EVENT code for the wall sensor
+*/
+#define SCRIPT_EVENT_WALL 9
+/*! \def SCRIPT_EVENT_PLAY_BUTTON
+	\brief OI_OPCODE_WAIT_EVENT code for the play button
+*/
+#define SCRIPT_EVENT_PLAY_BUTTON 17
+
+/*! \def SCRIPT_RUNNING
+	\brief script_poll(): the Create is still running the script
+*/
+#define SCRIPT_RUNNING 0
+/*! \def SCRIPT_DONE
+	\brief script_poll(): the script ran to its end
+*/
+#define SCRIPT_DONE 1
+/*! \def SCRIPT_ABORTED
+	\brief script_poll(): the Create stopped the script for a cliff or wheel drop
+*/
+#define SCRIPT_ABORTED 2
+/*! \def SCRIPT_TIMEOUT
+	\brief script_poll(): the script took far longer than expected, for example a wait that can't finish because the robot is stuck
+*/
+#define SCRIPT_TIMEOUT 3
+
+//! A script being built.
+typedef struct {
+	uint8_t bytes[SCRIPT_MAX]; /*!< Commands, without the OI_OPCODE_SCRIPT header */
+	uint8_t length;            /*!< Bytes used */
+	unsigned long duration;    /*!< Expected run time in ms */
+	uint8_t open_ended;        /*!< Has a wait for an event, so there is no telling how long it runs */
+} oi_script;
+
+/// Loads the marker songs. Call once after oi_init().
+void script_init(void);
+
+/// Starts an empty script.
+void script_begin(oi_script* s);
+
+/// Adds a straight drive.
+/**
+* @param velocity wheel speed in mm/s, 1 to 500. The sign is taken from distance.
+* @param distance how far to go in Create distance units (mm, uncalibrated). Negative drives backwards.
+* @return 1 if the step fit in the script, 0 if not
+*/
+char script_drive(oi_script* s, int16_t velocity, int16_t distance);
+
+/// Adds a turn in place.
+/**
+* @param velocity wheel speed in mm/s, 1 to 500
+* @param degrees how far to turn in Create angle units (uncalibrated). Positive is counterclockwise.
+* @return 1 if the step fit in the script, 0 if not
+*/
+char script_turn(oi_script* s, int16_t velocity, int16_t degrees);
+
+/// Adds a pause with the wheels stopped.
+/**
+* @param tenths time to wait in tenths of a second
+* @return 1 if the step fit in the script, 0 if not
+*/
+char script_wait_time(oi_script* s, uint8_t tenths);
+
+/// Adds a wait for a Create event, keeping the wheels as the previous step left them.
+/**
+* script_poll() never times out a script with an event wait in it.
+* @param event a SCRIPT_EVENT_ code, negated to wait for the event to end
+* @return 1 if the step fit in the script, 0 if not
+*/
+char script_wait_event(oi_script* s, int8_t event);
+
+/// Uploads a script and starts it.
+/**
+* Returns right away. Call script_poll() with every sensor frame until it stops returning SCRIPT_RUNNING.
+*/
+void script_play(oi_script* s);
+
+/// Checks on the script started by script_play().
+/**
+* @param self the latest sensor frame from oi_update()
+* @return SCRIPT_RUNNING, SCRIPT_DONE, SCRIPT_ABORTED, or SCRIPT_TIMEOUT
+*/
+uint8_t script_poll(const oi_t* self);
+
+#endif
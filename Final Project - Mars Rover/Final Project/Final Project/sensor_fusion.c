@@ -0,0 +1,63 @@
+/*
+ * sensor_fusion.c
+ *
+ * IR/SONAR sensor fusion. See sensor_fusion.h.
+ */
+
+#include "sensor_fusion.h"
+
+/* How much the IR sensor is trusted at a given range (0-255) */
+static uint8_t ir_weight(int cm) {
+	if (cm <= 0 || cm >= FUSION_SONAR_VALID)
+		return 0;
+	if (cm <= FUSION_IR_VALID)
+		return 255;
+	return 255 - (uint16_t) (cm - FUSION_IR_VALID) * 255 / (FUSION_SONAR_VALID - FUSION_IR_VALID);
+}
+
+/* How much the SONAR sensor is trusted at a given range (0-255). Close up the wide beam makes it less useful than the IR. */
+static uint8_t sonar_weight(int cm) {
+	if (cm <= 2 || cm >= FUSION_SONAR_MAX)
+		return 0;
+	if (cm <= FUSION_IR_VALID)
+		return 96;
+	if (cm >= FUSION_SONAR_VALID)
+		return 255;
+	return 96 + (uint16_t) (cm - FUSION_IR_VALID) * (255 - 96) / (FUSION_SONAR_VALID - FUSION_IR_VALID);
+}
+
+uint8_t fuse_range(int ir_cm, int sonar_cm, int* fused_cm) {
+	uint8_t w_ir = ir_weight(ir_cm);
+	uint8_t w_sonar = sonar_weight(sonar_cm);
+	int difference = ir_cm - sonar_cm;
+	int tolerance = 3 + ((ir_cm < sonar_cm) ? ir_cm : sonar_cm) / 8; // Readings within 3 cm + 12.5% agree
+	
+	if (difference < 0)
+		difference = -difference;
+	
+	if (w_ir == 0 && w_sonar == 0) { // Nothing usable
+		*fused_cm = FUSION_NO_RANGE;
+		return 0;
+	}
+	
+	if (difference <= tolerance) { // Sensors agree. Blend them.
+		uint16_t total = (uint16_t) w_ir + w_sonar;
+		uint16_t confidence = ((w_ir > w_sonar) ? w_ir : w_sonar) + ((w_ir > w_sonar) ? w_sonar : w_ir) / 2;
+		*fused_cm = ((int32_t) ir_cm * w_ir + (int32_t) sonar_cm * w_sonar) / total;
+		return (confidence > 255) ? 255 : confidence;
+	}
+	
+	/* Sensors disagree. Reject the outlier. */
+	if (w_ir > 0) { // IR sees something in its range. SONAR is either off-axis or missed the echo.
+		*fused_cm = ir_cm;
+		return w_ir / 2;
+	}
+	
+	if (sonar_cm >= FUSION_SONAR_VALID) { // Out of IR range. Only the SONAR can see this far.
+		*fused_cm = sonar_cm;
+		return w_sonar / 2;
+	}
+	
+	*fused_cm = FUSION_NO_RANGE; // Close SONAR echo the IR can't see. Something beside the beam.
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*! \file sensor_fusion.h
+    \brief Combines the IR and SONAR readings taken at one servo angle into a single range.
+	
+	The IR sensor has a narrow beam but is only accurate up to about 50 cm. The SONAR sensor
+	measures range well out to about 3 m but its wide beam also picks up objects off to the side.
+	Each reading is weighted by how trustworthy its sensor is at that range, and a reading that
+	disagrees with a more trustworthy one is rejected.
+*/
+
+#ifndef SENSOR_FUSION_H
+#define SENSOR_FUSION_H
+
+#include <inttypes.h>
+
+/*! \def FUSION_IR_VALID
+	\brief IR readings are fully trusted up to this distance (in cm)
+*/
+#define FUSION_IR_VALID 40
+/*! \def FUSION_SONAR_VALID
+	\brief SONAR readings are fully trusted beyond this distance (in cm)
+*/
+#define FUSION_SONAR_VALID 60
+/*! \def FUSION_SONAR_MAX
+	\brief SONAR readings at or beyond this distance (in cm) mean no echo was received
+*/
+#define FUSION_SONAR_MAX 341
+/*! \def FUSION_NO_RANGE
+	\brief Fused range reported when neither sensor has a usable reading
+*/
+#define FUSION_NO_RANGE 341
+
+/// Fuses one IR and one SONAR reading.
+/**
+* Readings that agree are averaged using their weights. When they disagree, the IR reading wins inside its valid range (a closer SONAR echo comes from an object beside the beam), the SONAR reading wins beyond it, and a close SONAR echo the IR sensor can't see is dropped.
+* @param ir_cm distance measured by the IR sensor
+* @param sonar_cm distance measured by the SONAR sensor
+* @param fused_cm set to the fused range, or FUSION_NO_RANGE
+* @return confidence in the fused range, from 0 (none) to 255
+*/
+uint8_t fuse_range(int ir_cm, int sonar_cm, int* fused_cm);
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * sequence.c
+ *
+ * Operator command sequences. See sequence.h.
+ */
+
+#include <string.h>
+#include "sequence.h"
+
+//! A stored macro.
+typedef struct {
+	char name;                     /*!< 'a' to 'z', or 0 for a free slot */
+	char body[SEQ_MACRO_SIZE + 1]; /*!< Checked when it was defined */
+} seq_macro;
+
+//! Where seq_run() is.
+typedef struct {
+	char run;           /*!< Run the steps, or only check them */
+	char live;          /*!< While checking: the steps being checked will run, so macros they define will exist */
+	uint32_t defined;   /*!< While checking: macros that exist at this point, one bit per letter */
+	uint8_t slots;      /*!< While checking: macro slots in use at this point */
+	seq_step step;      /*!< From seq_run() */
+	void* context;      /*!< From seq_run() */
+	const char* error;  /*!< Where the error was found */
+} seq_state;
+
+static seq_macro macros[SEQ_MACROS];
+static uint8_t error_at;
+
+static seq_macro* find_macro(char name) {
+	for (uint8_t i = 0; i < SEQ_MACROS; i++) {
+		if (macros[i].name == name)
+			return &macros[i];
+	}
+	return 0;
+}
+
+/* Reads an optionally signed decimal number. Returns 0 if there isn't one or it doesn't fit in 16 bits. */
+static char read_number(const char** p, int16_t* value) {
+	char negative = 0;
+	long n = 0;
+	const char* start;
+
+	if (**p == '-') {
+		negative = 1;
+		(*p)++;
+	}
+	start = *p;
+	while (**p >= '0' && **p <= '9') {
+		n = n * 10 + (**p - '0');
+		if (n > 32767)
+			return 0;
+		(*p)++;
+	}
+	if (*p == start)
+		return 0;
+
+	*value = negative ? -n : n;
+	return 1;
+}
+
+/* Runs (or checks) steps up to the end of the text or a closing parenthesis, which is left for the caller. */
+static uint8_t run_block(seq_state* s, const char** p, uint8_t depth) {
+	uint8_t result;
+
+	if (depth > SEQ_MAX_DEPTH) {
+		s->error = *p;
+		return SEQ_TOO_DEEP;
+	}
+
+	while (**p != 0 && **p != ')') {
+		const char* at = *p;
+		char c = *at;
+		int16_t value = 0;
+
+		if (c == ' ' || c == ',' || c == '\r' || c == '\n') {
+			(*p)++;
+		} else if (c == SEQ_MOVE || c == SEQ_ROTATE || c == SEQ_WAIT || c == SEQ_SWEEP) {
+			(*p)++;
+			if (c != SEQ_SWEEP && !read_number(p, &value)) {
+				s->error = at;
+				return SEQ_SYNTAX;
+			}
+			if (s->run && !s->step(c, value, s->context)) {
+				s->error = at;
+				return SEQ_STOPPED;
+			}
+		} else if (c >= '0' && c <= '9') { // Loop
+			const char* body;
+			const char* end = 0;
+			int16_t count;
+
+			read_number(p, &count);
+			if (**p != '(') {
+				s->error = *p;
+				return SEQ_SYNTAX;
+			}
+			body = *p + 1;
+
+			// When checking, or for a loop that runs no times, the body is only checked
+			char run = s->run;
+			char live = s->live;
+			if (count == 0) {
+				count = 1;
+				s->run = 0;
+				s->live = 0;
+			}
+			for (int16_t i = 0; i < count; i++) {
+				end = body;
+				result = run_block(s, &end, depth + 1);
+				if (result != SEQ_OK)
+					return result;
+				if (!s->run)
+					break;
+			}
+			s->run = run;
+			s->live = live;
+
+			if (*end != ')') {
+				s->error = end;
+				return SEQ_SYNTAX;
+			}
+			*p = end + 1;
+		} else if (c == '=') { // Macro definition
+			char name = at[1];
+			const char* body = at + 3;
+			const char* end = body;
+
+			if (name < 'a' || name > 'z' || at[2] != '(' || !s->live) { // A definition that might never run can't be checked against
+				s->error = at;
+				return SEQ_SYNTAX;
+			}
+
+			char run = s->run;
+			s->run = 0; // Defining a macro doesn't run it
+			s->live = 0;
+			result = run_block(s, &end, depth + 1);
+			s->run = run;
+			s->live = 1;
+			if (result != SEQ_OK)
+				return result;
+			if (*end != ')') {
+				s->error = end;
+				return SEQ_SYNTAX;
+			}
+			if (end - body > SEQ_MACRO_SIZE) {
+				s->error = at;
+				return SEQ_NO_ROOM;
+			}
+
+			if (!s->run) {
+				if (!(s->defined & (1UL << (name - 'a')))) {
+					if (++s->slots > SEQ_MACROS) {
+						s->error = at;
+						return SEQ_NO_ROOM;
+					}
+					s->defined |= 1UL << (name - 'a');
+				}
+			} else {
+				seq_macro* m = find_macro(name);
+				if (!m)
+					m = find_macro(0); // Checking made sure there is a free slot
+				m->name = name;
+				memcpy(m->body, body, end - body);
+				m->body[end - body] = 0;
+			}
+			*p = end + 1;
+		} else if (c >= 'a' && c <= 'z') { // Macro call
+			(*p)++;
+			if (!s->run) {
+				if (!(s->defined & (1UL << (c - 'a')))) {
+					s->error = at;
+					return SEQ_UNKNOWN_MACRO;
+				}
+			} else {
+				seq_macro* m = find_macro(c);
+				if (!m) { // Checking should have caught it
+					s->error = at;
+					return SEQ_UNKNOWN_MACRO;
+				}
+				const char* body = m->body;
+
+				result = run_block(s, &body, depth + 1);
+				if (result != SEQ_OK) {
+					s->error = at; // Report the call, the body isn't part of the text
+					return result;
+				}
+			}
+		} else {
+			s->error = at;
+			return SEQ_SYNTAX;
+		}
+	}
+
+	return SEQ_OK;
+}
+
+uint8_t seq_run(const char* text, seq_step step, void* context) {
+	seq_state s;
+	const char* p = text;
+	uint8_t result;
+
+	s.step = step;
+	s.context = context;
+	s.defined = 0;
+	s.slots = 0;
+	for (uint8_t i = 0; i < SEQ_MACROS; i++) {
+		if (macros[i].name) {
+			s.defined |= 1UL << (macros[i].name - 'a');
+			s.slots++;
+		}
+	}
+
+	// Check everything first
+	s.run = 0;
+	s.live = 1;
+	result = run_block(&s, &p, 0);
+	if (result == SEQ_OK && *p != 0) { // Unmatched closing parenthesis
+		s.error = p;
+		result = SEQ_SYNTAX;
+	}
+
+	if (result == SEQ_OK) {
+		p = text;
+		s.run = 1;
+		result = run_block(&s, &p, 0);
+	}
+
+	error_at = (result == SEQ_OK) ? 0 : s.error - text;
+	return result;
+}
+
+uint8_t seq_error_at(void) {
+	return error_at;
+}
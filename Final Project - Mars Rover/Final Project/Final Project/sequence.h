@@ -0,0 +1,105 @@
+/*! \file sequence.h
+    \brief Parser and interpreter for operator command sequences.
+
+	A sequence is one line of text that the robot runs on its own, so a manoeuvre of many steps costs
+	one bluetooth round trip and one report instead of one per step.
+
+	Steps (numbers may be negative):
+	- M<cm>  move (negative backs up)
+	- R<deg> rotate (positive is counterclockwise)
+	- S      sweep
+	- W<ms>  wait
+	- <n>(...)  run what is in the parentheses n times
+	- =<a-z>(...)  define a macro; it is kept for later sequences
+	- <a-z>  run a macro
+
+	A macro can't be defined inside another macro or inside a loop that runs 0 times.
+	Spaces and commas between steps are ignored. Example: "=b(M30 R90) 4(b) S" drives a square and then sweeps.
+	The whole sequence is checked before the first step runs, so a typo never leaves the robot halfway through.
+*/
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <inttypes.h>
+
+/*! \def SEQ_MAX_TEXT
+	\brief Longest sequence accepted, in characters
+*/
+#define SEQ_MAX_TEXT 96
+/*! \def SEQ_MACROS
+	\brief Number of macros kept
+*/
+#define SEQ_MACROS 4
+/*! \def SEQ_MACRO_SIZE
+	\brief Longest macro body, in characters
+*/
+#define SEQ_MACRO_SIZE 32
+/*! \def SEQ_MAX_DEPTH
+	\brief Deepest nesting of loops and macro calls. Also stops macros that call themselves.
+*/
+#define SEQ_MAX_DEPTH 6
+
+/* Steps passed to the seq_step callback */
+/*! \def SEQ_MOVE
+	\brief Move, argument in cm
+*/
+#define SEQ_MOVE 'M'
+/*! \def SEQ_ROTATE
+	\brief Rotate, argument in degrees
+*/
+#define SEQ_ROTATE 'R'
+/*! \def SEQ_SWEEP
+	\brief Sweep, argument unused
+*/
+#define SEQ_SWEEP 'S'
+/*! \def SEQ_WAIT
+	\brief Wait, argument in ms
+*/
+#define SEQ_WAIT 'W'
+
+/* Results of seq_run() */
+/*! \def SEQ_OK
+	\brief The whole sequence ran
+*/
+#define SEQ_OK 0
+/*! \def SEQ_SYNTAX
+	\brief Something that isn't a step, unbalanced parentheses, or a macro defined where it might not run
+*/
+#define SEQ_SYNTAX 1
+/*! \def SEQ_UNKNOWN_MACRO
+	\brief A macro is run before it is defined
+*/
+#define SEQ_UNKNOWN_MACRO 2
+/*! \def SEQ_TOO_DEEP
+	\brief Loops and macro calls nest deeper than SEQ_MAX_DEPTH
+*/
+#define SEQ_TOO_DEEP 3
+/*! \def SEQ_NO_ROOM
+	\brief More than SEQ_MACROS macros, or a body longer than SEQ_MACRO_SIZE
+*/
+#define SEQ_NO_ROOM 4
+/*! \def SEQ_STOPPED
+	\brief A step asked to stop, for a hazard or because the operator sent something
+*/
+#define SEQ_STOPPED 5
+
+/// Runs one step. Returns 0 to stop the sequence.
+typedef char (*seq_step)(uint8_t step, int16_t argument, void* context);
+
+/// Checks a sequence and runs it.
+/**
+* @param text the sequence, null terminated
+* @param step called for every step in order
+* @param context passed to step
+* @return SEQ_OK or one of the errors. Nothing has run if it is a syntax, macro, or room error found while checking.
+*/
+uint8_t seq_run(const char* text, seq_step step, void* context);
+
+/// Where in the text seq_run() stopped.
+/**
+* @return offset in the sequence of the character where the error was found. Errors inside a macro are reported at the call.
+*/
+uint8_t seq_error_at(void);
+
+#endif
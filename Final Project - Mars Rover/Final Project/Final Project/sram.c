@@ -0,0 +1,70 @@
+/*
+ * sram.c
+ *
+ * SRAM and stack usage instrumentation. See sram.h.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "util.h"
+#include "sram.h"
+
+extern uint8_t _end; // End of .bss, set by the linker
+extern uint8_t __stack; // Top of SRAM, set by the linker
+extern char *__brkval; // Top of the heap, 0 until malloc is first called. Set by avr-libc.
+
+void sram_paint(void) __attribute__ ((naked, used, section (".init1")));
+
+/* Paints SRAM from _end to the top of the stack. Runs before the C runtime sets anything up, so it can't use the stack or rely on any register values. */
+void sram_paint(void) {
+	__asm volatile (
+		"    ldi r30, lo8(_end)\n"
+		"    ldi r31, hi8(_end)\n"
+		"    ldi r24, %0\n"
+		"    ldi r25, hi8(__stack)\n"
+		"    rjmp 2f\n"
+		"1:  st Z+, r24\n"
+		"2:  cpi r30, lo8(__stack)\n"
+		"    cpc r31, r25\n"
+		"    brlo 1b\n"
+		"    breq 1b\n"
+		:: "M" (SRAM_PAINT)
+	);
+}
+
+/* Lowest address the stack can't use. */
+static uint8_t* heap_top(void) {
+	return (__brkval == 0) ? &_end : (uint8_t*) __brkval;
+}
+
+unsigned int sram_static_size(void) {
+	return &_end - (uint8_t*) RAMSTART;
+}
+
+unsigned int sram_heap_size(void) {
+	return heap_top() - &_end;
+}
+
+unsigned int sram_free_now(void) {
+	uint8_t here; // Lives at the current top of the stack
+	
+	return &here - heap_top();
+}
+
+unsigned int sram_free_min(void) {
+	uint8_t *p = heap_top();
+	
+	while (p <= &__stack && *p == SRAM_PAINT) // The first byte that lost its paint is the deepest the stack has been
+		p++;
+	
+	return p - heap_top();
+}
+
+void sram_report(void) {
+	char buffer[100];
+	
+	sprintf_P(buffer, PSTR("\r\nSRAM: static %u, heap %u, free %u, free at deepest stack %u\r\n"), sram_static_size(), sram_heap_size(), sram_free_now(), sram_free_min());
+	send_message(buffer);
+}
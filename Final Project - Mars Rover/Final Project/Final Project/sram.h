@@ -0,0 +1,38 @@
+/*! \file sram.h
+    \brief SRAM and stack usage instrumentation.
+	
+	At boot, before anything else runs, all SRAM between the end of the static variables and the top
+	of the stack is painted with SRAM_PAINT. Stack that has ever been used no longer holds the paint, so
+	scanning for it gives the deepest the stack has ever reached. For a per-function breakdown, the
+	build writes stack_usage.txt next to the .elf from the compiler's -fstack-usage output.
+*/
+
+#ifndef SRAM_H
+#define SRAM_H
+
+#include <inttypes.h>
+
+/*! \def SRAM_PAINT
+	\brief Value painted over unused SRAM at boot
+*/
+#define SRAM_PAINT 0xC5
+
+/// Bytes of SRAM used by static and global variables (.data and .bss).
+unsigned int sram_static_size(void);
+
+/// Bytes of SRAM currently handed out by malloc/calloc (including oi_alloc()).
+unsigned int sram_heap_size(void);
+
+/// Bytes of SRAM currently free between the top of the heap and the stack pointer.
+unsigned int sram_free_now(void);
+
+/// Bytes of SRAM between the top of the heap and the deepest the stack has ever reached.
+/**
+* This is how much more stack could have been used without running into the heap. A value near zero means the firmware is close to crashing.
+*/
+unsigned int sram_free_min(void);
+
+/// Sends the SRAM usage over bluetooth.
+void sram_report(void);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * surface.c
+ *
+ * Cliff and tape classifier. See surface.h.
+ */
+
+#include <avr/pgmspace.h>
+#include "object_tracking.h"
+#include "surface.h"
+
+/* Signal bands for each sensor: white tape is white_low to white_high, red tape is red_low and up. Measured on bot 17. */
+typedef struct {
+	uint8_t side;
+	uint16_t white_low;
+	uint16_t white_high;
+	uint16_t red_low;
+} surface_thresholds;
+
+static const surface_thresholds thresholds[SURFACE_CHANNELS] PROGMEM = {
+	{LEFT, 451, 559, 781},    // SURFACE_LEFT
+	{MIDDLE, 741, 849, 1101}, // SURFACE_FRONT_LEFT
+	{MIDDLE, 351, 459, 641},  // SURFACE_FRONT_RIGHT
+	{RIGHT, 481, 559, 761}    // SURFACE_RIGHT
+};
+
+static uint8_t current[SURFACE_CHANNELS];   // Accepted surface
+static uint8_t candidate[SURFACE_CHANNELS]; // Surface being debounced
+static uint8_t seen[SURFACE_CHANNELS];      // Frames in a row candidate was seen
+
+/* What a sensor is over in this frame, leaning towards what it was already over */
+static uint8_t classify(uint8_t channel, uint16_t signal, uint8_t cliff) {
+	uint16_t white_low = pgm_read_word(&thresholds[channel].white_low);
+	uint16_t white_high = pgm_read_word(&thresholds[channel].white_high);
+	uint16_t red_low = pgm_read_word(&thresholds[channel].red_low);
+	uint8_t now = current[channel];
+	
+	if (cliff)
+		return CLIFF;
+	
+	if (now == RED ? signal + SURFACE_HYSTERESIS >= red_low : signal >= red_low)
+		return RED;
+	
+	if (now == WHITE ? (signal + SURFACE_HYSTERESIS >= white_low && signal <= white_high + SURFACE_HYSTERESIS) : (signal >= white_low && signal <= white_high))
+		return WHITE;
+	
+	return SURFACE_FLOOR;
+}
+
+uint8_t surface_update(oi_t* self, surface_event* events) {
+	uint16_t signals[SURFACE_CHANNELS] = {self->cliff_left_signal, self->cliff_frontleft_signal, self->cliff_frontright_signal, self->cliff_right_signal};
+	uint8_t cliffs[SURFACE_CHANNELS] = {self->cliff_left, self->cliff_frontleft, self->cliff_frontright, self->cliff_right};
+	uint8_t count = 0;
+	
+	for (uint8_t i = 0; i < SURFACE_CHANNELS; i++) {
+		uint8_t surface = classify(i, signals[i], cliffs[i]);
+		
+		if (surface == current[i]) { // Nothing new
+			seen[i] = 0;
+			continue;
+		}
+		
+		if (surface != candidate[i]) { // Start debouncing it
+			candidate[i] = surface;
+			seen[i] = 0;
+		}
+		
+		if (++seen[i] < (surface == CLIFF ? SURFACE_CLIFF_DEBOUNCE : SURFACE_DEBOUNCE))
+			continue;
+		
+		uint8_t side = pgm_read_byte(&thresholds[i].side);
+		
+		if (current[i] != SURFACE_FLOOR) { // Left what it was over
+			events[count].channel = i;
+			events[count].side = side;
+			events[count].surface = current[i];
+			events[count].entered = 0;
+			count++;
+		}
+		
+		if (surface != SURFACE_FLOOR) { // Now over something new
+			events[count].channel = i;
+			events[count].side = side;
+			events[count].surface = surface;
+			events[count].entered = 1;
+			count++;
+		}
+		
+		current[i] = surface;
+		seen[i] = 0;
+	}
+	
+	return count;
+}
+
+uint8_t surface_current(uint8_t channel) {
+	return current[channel];
+}
+
+void surface_reset(void) {
+	for (uint8_t i = 0; i < SURFACE_CHANNELS; i++) {
+		current[i] = SURFACE_FLOOR;
+		candidate[i] = SURFACE_FLOOR;
+		seen[i] = 0;
+	}
+}
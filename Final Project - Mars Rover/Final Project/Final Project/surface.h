@@ -0,0 +1,77 @@
+/*! \file surface.h
+    \brief Floor classifier for the four cliff sensors.
+	
+	Each cliff sensor's signal is classified as floor, white tape, or red tape using a per-sensor
+	thresholds table, or as a cliff when the Create reports one. A sensor has to leave a band by
+	SURFACE_HYSTERESIS before it counts as having left, and a new surface has to be seen on
+	SURFACE_DEBOUNCE frames in a row before it is accepted. Every accepted change is reported once
+	as an event, so a tape line is logged once per crossing.
+*/
+
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <inttypes.h>
+#include "open_interface.h"
+
+/*! \def SURFACE_LEFT
+	\brief Channel of the left cliff sensor
+*/
+#define SURFACE_LEFT 0
+/*! \def SURFACE_FRONT_LEFT
+	\brief Channel of the front left cliff sensor
+*/
+#define SURFACE_FRONT_LEFT 1
+/*! \def SURFACE_FRONT_RIGHT
+	\brief Channel of the front right cliff sensor
+*/
+#define SURFACE_FRONT_RIGHT 2
+/*! \def SURFACE_RIGHT
+	\brief Channel of the right cliff sensor
+*/
+#define SURFACE_RIGHT 3
+/*! \def SURFACE_CHANNELS
+	\brief Number of cliff sensors
+*/
+#define SURFACE_CHANNELS 4
+/*! \def SURFACE_FLOOR
+	\brief Surface code for plain floor. The other surfaces use CLIFF, WHITE, and RED from object_tracking.h.
+*/
+#define SURFACE_FLOOR 0
+/*! \def SURFACE_HYSTERESIS
+	\brief How far (in signal units) past a band's edge a sensor must go to leave it
+*/
+#define SURFACE_HYSTERESIS 20
+/*! \def SURFACE_DEBOUNCE
+	\brief Frames in a row a new tape or floor reading must last to be accepted
+*/
+#define SURFACE_DEBOUNCE 3
+/*! \def SURFACE_CLIFF_DEBOUNCE
+	\brief Frames in a row a cliff must last to be accepted. Kept at 1 so the robot stops right away.
+*/
+#define SURFACE_CLIFF_DEBOUNCE 1
+
+//! A sensor started or stopped seeing a surface.
+typedef struct {
+	uint8_t channel; /*!< SURFACE_LEFT to SURFACE_RIGHT */
+	uint8_t side;    /*!< LEFT, MIDDLE, or RIGHT, as log_position() takes it */
+	uint8_t surface; /*!< CLIFF, WHITE, or RED */
+	uint8_t entered; /*!< 1 if the sensor is now over the surface, 0 if it just left it */
+} surface_event;
+
+/// Classifies one sensor frame.
+/**
+* Call once after every oi_update().
+* @param self the latest sensor frame
+* @param events array of at least 2 * SURFACE_CHANNELS that receives what changed
+* @return number of events
+*/
+uint8_t surface_update(oi_t* self, surface_event* events);
+
+/// Surface a channel is over right now.
+uint8_t surface_current(uint8_t channel);
+
+/// Forgets every sensor's surface, so whatever is under the robot is reported again.
+void surface_reset(void);
+
+#endif
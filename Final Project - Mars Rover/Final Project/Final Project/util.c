@@ -12,9 +12,15 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
 #include <stdio.h>
 #include <math.h>
 #include "util.h"
+#include "fixed_math.h"
+#include "calibration.h"
+#include "profile.h"
+#include "idle.h"
 
 // Global used for interrupt driven delay functions
 volatile unsigned int timer2_tick;
@@ -29,8 +35,11 @@ void wait_ms(unsigned int time_val) {
 	timer2_tick=0;
 	timer2_start(0);
 
-	//Waiting for time
-	while(timer2_tick < time_val);
+	//Sleeping until enough ticks have woken it
+	cli();
+	while(timer2_tick < time_val)
+		idle_sleep();
+	sei();
 
 	timer2_stop();
 }
@@ -71,9 +80,13 @@ void ADC_init()
 	// REFS=11, ADLAR= 0, MUX don't care
 	ADMUX |= (3<<REFS0) | (2<<MUX0); //(REFS1) | _BV(REFS0);
 	
-	// ADEN=1, ADFR=0, ADIE=0, ADPS=111, others don't care.
+	// ADEN=1, ADFR=0, ADIE=1, ADPS=111, others don't care.
 	//See page 246 of user guide
-	ADCSRA |= (1<<ADEN) | (7<<ADPS0);
+	ADCSRA |= (1<<ADEN) | (1<<ADIE) | (7<<ADPS0);
+}
+
+/* Conversion complete. Only there to wake read_ADC() */
+ISR(ADC_vect) {
 }
 
 unsigned int read_ADC()
@@ -81,20 +94,38 @@ unsigned int read_ADC()
 	ADMUX |= (PF2 & 0x1F);
 	//Sets ADSC bit of ADCSRA, enabling ADC
 	ADCSRA |= (1<<ADSC);
-	//Waits for conversion to be done.
-	while(ADCSRA & (1<<ADFR)){}
+	//Sleeps until the conversion is done (ADSC clears).
+	cli();
+	while(ADCSRA & (1<<ADSC))
+		idle_sleep();
+	sei();
 	//Sets conversion to temp var.
 	return ADC;
 }
 
-int read_IR_distance() {
-	int sum = 0;
+unsigned int read_IR_raw() {
+	unsigned int sum = 0;
 	for (int i = 0; i < 5; i++)
 	sum += read_ADC();
 	
-	int quantVal = sum/5;
+	return sum/5;
+}
+
+unsigned int read_IR_distance_mm() {
+	PROF_BEGIN(PROF_READ_IR);
 	
-	return (pow(quantVal,-1.171) * 31427);
+	unsigned int quantVal = read_IR_raw();
+	uint16_t distance = 27520; // Approximate IR Range Limit
+	
+	if (quantVal != 0) // distance = 10 * K * quantVal^-p, evaluated as 2^(log2(10) + log2(K) - p * log2(quantVal)) in fixed point
+		distance = fx_exp2(850 + cal_store.ir_log2_coeff - (((int32_t) cal_store.ir_exponent * fx_log2(quantVal)) >> 8));
+	
+	PROF_END(PROF_READ_IR);
+	return (distance > 27520) ? 27520 : distance;
+}
+
+int read_IR_distance() {
+	return read_IR_distance_mm() / 10;
 }
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
@@ -111,12 +142,12 @@ void ping_timer_init()
 {
 	TCCR1A = 0x00;		// WGM1[1:0]=00
 	TCCR1B = 0b11000011; // Noise canceller ON, falling edge is trigger, prescaler of 64
-	TIMSK = 1 << TICIE1; // Enable TICIE1
+	TIMSK |= (1 << TICIE1) | (1 << TOIE1); // Enable TICIE1, and TOIE1 for the uptime clock
 }
 
 void send_pulse()
 {
-	TIMSK &= ~0b00100100;
+	TIMSK &= ~(1 << TICIE1); // Leave TOIE1 on so the uptime clock keeps counting
 	DDRD |= 0x10;
 	PORTD |= 0x10;
 	wait_ms(1);
@@ -149,8 +180,37 @@ ISR(TIMER1_CAPT_vect)
 	TCCR1B ^= 0b01000000;
 }
 
+volatile unsigned int timer1_overflows = 0;
+
+/* Timer1 wrapped around (every 262 ms) */
+ISR(TIMER1_OVF_vect)
+{
+	timer1_overflows++;
+}
+
+unsigned long uptime_ticks() {
+	unsigned int high, low;
+	
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		high = timer1_overflows;
+		low = TCNT1;
+		if ((TIFR & (1 << TOV1)) && low < 0x8000) // Wrapped after interrupts were disabled
+			high++;
+	}
+	
+	return ((unsigned long) high << 16) | low;
+}
+
+unsigned int read_PING_ticks() {
+	return signal;
+}
+
 float read_PING_distance() {
-	return ((signal/(16000000.0/64.0))*(34300.0/2.0)); // (delta/(Frequency/pre-scaler))*(speed of sound/2)
+	PROF_BEGIN(PROF_READ_PING);
+	float distance = ((signal/(16000000.0/64.0))*(34300.0/2.0)); // (delta/(Frequency/pre-scaler))*(speed of sound/2)
+	PROF_END(PROF_READ_PING);
+	
+	return distance;
 }
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
@@ -159,9 +219,9 @@ float read_PING_distance() {
 /* Servo Program                                                        */
 /************************************************************************/
 #define TOP (16000000/(8 * 1000)) * 21.5                 // pulse period in cycles; (clock_frequency/(prescaler * 1000)) * pulse period
-#define ZERO ((16000000/(8 * 1000)) * 1) * 0.45         // 1 ms pulse - clockwise far end; ((16000000/(8 * 1000)) * 1ms) * .5075 (0.4 for bot 3; 0.45 for bot 17; 0.35 for bot 12; 0.59 for bot 11) calibration
-#define NINTY ((16000000/(8 * 1000)) * 1.5) * 0.8833     // 1.5 ms pulse - center position; ((16000000/(8 * 1000)) * 1.5ms) * .9397 (0.816666 for bot 3; 0.8833 for bot 17, 0.826 for bot 12; 0.9733 for bot 11) calibration
-#define ONE_EIGHTY ((16000000/(8 * 1000)) * 2) * 1.0875  // 2 ms pulse - counterclockwise far end; ((16000000/(8 * 1000)) * 2ms) * 1.1362 (1.0375 for bot 3 & 12; 1.0875 for bot 17; 1.185 for bot 11) calibration
+#define ZERO cal_store.servo_zero                        // 1 ms pulse - clockwise far end; fitted by calibrate_servo()
+#define NINTY ((ZERO + ONE_EIGHTY) / 2)                  // 1.5 ms pulse - center position
+#define ONE_EIGHTY cal_store.servo_one_eighty            // 2 ms pulse - counterclockwise far end; fitted by calibrate_servo()
 
 void servo_timer_init() {
 	TCCR3A = 0b00100011; //set COM and WGM
@@ -186,12 +246,23 @@ void move_servo(volatile float* degrees)
 	*degrees = 0;
 }
 
+void servo_set_pulse(unsigned int pulse)
+{
+	if (pulse < TOP) // Pulse can't be longer than the period
+	OCR3B = pulse;
+}
+
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
 
 /************************************************************************/
 /* USART Program (Bluetooth)                                            */
 /************************************************************************/
+
+// Bytes from the operator, filled by the receive interrupt so USART_Receive() can sleep
+static volatile unsigned char rx_buffer[USART_RX_BUFFER];
+static volatile uint8_t rx_head, rx_tail;
+
 /************************************************************************/
 /* Readies the USART for communication                                  */
 /* ubrr constitutes: clock rate / (system bit / speed) / (baud rate - 1)*/
@@ -206,7 +277,7 @@ void USART_Init(unsigned int ubrr)
 	UBRR0L = (unsigned char) ubrr;
 	
 	UCSR0A = (1 << U2X0); /* Steps Double Speed Asynchronous mode of communication */
-	UCSR0B = (1 << RXEN0) | (1 << TXEN); /* Enable receiver and transmitter */
+	UCSR0B = (1 << RXCIE0) | (1 << RXEN0) | (1 << TXEN); /* Enable receiver, its interrupt, and transmitter */
 
 	UCSR0C = (1 << USBS0) | (3 << UCSZ00); /* Set frame format: 8data, 2stop bit */
 }
@@ -221,23 +292,78 @@ void USART_Transmit(unsigned char data)
 	UDR0 = data; /* Put data into buffer, sends the data */
 }
 /************************************************************************/
+/* Keeps each received character until USART_Receive takes it.         */
+/* A character that arrives with the buffer full is dropped.            */
+/************************************************************************/
+ISR(USART0_RX_vect)
+{
+	unsigned char data = UDR0; /* Reading it clears the interrupt */
+	uint8_t next = (rx_head + 1) % USART_RX_BUFFER;
+	
+	if (next != rx_tail) {
+		rx_buffer[rx_head] = data;
+		rx_head = next;
+	}
+}
+/************************************************************************/
 /* Waits for data to be received and returns the sent character.        */
 /* Enabled by USART_Init                                                */
 /************************************************************************/
 unsigned char USART_Receive(void)
 {
-	/* Wait for data to be received */
-	while (!(UCSR0A & (1 << RXC0))) ;
+	unsigned char data;
+	
+	/* Sleep until data is received */
+	cli();
+	while (rx_head == rx_tail)
+		idle_sleep();
+	sei();
+	
+	data = rx_buffer[rx_tail]; /* Only the interrupt moves rx_head, so the tail needs no locking */
+	rx_tail = (rx_tail + 1) % USART_RX_BUFFER;
+	return data;
+}
+/************************************************************************/
+/* Checks if a received character is waiting without blocking           */
+/************************************************************************/
+unsigned char USART_Available(void)
+{
+	return rx_head != rx_tail;
+}
+/************************************************************************/
+/* Sleeps until a character arrives or ms milliseconds pass             */
+/************************************************************************/
+unsigned char USART_Wait(unsigned int ms)
+{
+	unsigned long start = uptime_ticks();
 	
-	return UDR0; /* Get and return received data from buffer */
+	idle_alarm(start + ms * 250UL); /* 4 us ticks */
+	cli();
+	while (rx_head == rx_tail && uptime_ticks() - start < ms * 250UL)
+		idle_sleep();
+	sei();
+	
+	return rx_head != rx_tail;
 }
 /************************************************************************/
 /* Calls USART_Transmit for each character in the array                 */
 /************************************************************************/
 void send_message(char *message)
 {
+	PROF_BEGIN(PROF_SEND_MESSAGE);
 	for (int i = 0; message[i] != '\0'; i++)
 		USART_Transmit(message[i]);
+	PROF_END(PROF_SEND_MESSAGE);
+}
+/************************************************************************/
+/* Same as send_message, for a string kept in flash with PSTR           */
+/************************************************************************/
+void send_message_P(const char *message)
+{
+	PROF_BEGIN(PROF_SEND_MESSAGE);
+	for (char c; (c = pgm_read_byte(message)) != '\0'; message++)
+		USART_Transmit(c);
+	PROF_END(PROF_SEND_MESSAGE);
 }
 /////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////
\ No newline at end of file
@@ -5,7 +5,15 @@
 	page 111 and 133-137 of the Atmel Mega128 User Guide
 */
 
+/*! \def USART_RX_BUFFER
+	\brief Characters from the operator kept until USART_Receive() takes them
+*/
+#define USART_RX_BUFFER 16
+
 /// Blocks for a specified number of milliseconds
+/**
+* The CPU sleeps between the timer 2 ticks (see idle.h).
+*/
 void wait_ms(unsigned int time_val);
 
 /// Start timer2
@@ -16,26 +24,38 @@ void timer2_stop();
 
 /// Initializes the Analog-to-Digital converter.
 /**
-* ADMUX: REFS=11, ADLAR= 0, MUX don't care; ADCSRA: ADEN=1, ADFR=0, ADIE=0, ADPS=111, others don't care.
+* ADMUX: REFS=11, ADLAR= 0, MUX don't care; ADCSRA: ADEN=1, ADFR=0, ADIE=1, ADPS=111, others don't care. The interrupt wakes read_ADC() when a conversion is done.
 */
 void ADC_init();
 
 /// Reads digitally converted values. Written by Dalton.
 /** 
-* Sets ADSC bit of ADCSRA, enabling ADC. 
+* Sets ADSC bit of ADCSRA, enabling ADC, and sleeps until the conversion is done.
 * @return ADC The conversion temp
 */
 unsigned int read_ADC();
 
+/// Reads the IR sensor without converting to a distance.
+/**
+* @return the average of five ADC samples
+*/
+unsigned int read_IR_raw();
+
 /// Converts the ADC value to centimeters. Written by Dalton and improved upon by Omar.
 /**
-* A function that takes the average of five ADC samples and calculates the corresponding centimeter value as a result.
+* A function that takes the average of five ADC samples and calculates the corresponding centimeter value using the IR curve in the calibration store.
 */
 int read_IR_distance();
 
+/// Converts the ADC value to millimeters.
+/**
+* Same as read_IR_distance() with ten times the resolution.
+*/
+unsigned int read_IR_distance_mm();
+
 /// Initializes the ping sensor.
 /** 
-* TCCR1A: WGM1[1:0]=00; TCCR1B: Noise canceller ON, falling edge is trigger, prescaler of 64; TIMSK: Enable TICIE1
+* TCCR1A: WGM1[1:0]=00; TCCR1B: Noise canceller ON, falling edge is trigger, prescaler of 64; TIMSK: Enable TICIE1 and TOIE1 (uptime clock)
 */
 void ping_timer_init();
 
@@ -48,6 +68,19 @@ void send_pulse();
 */
 float read_PING_distance();
 
+/// Reads the last SONAR echo time without converting it.
+/**
+* @return echo time in timer 1 ticks (4 us each at a prescaler of 64)
+*/
+unsigned int read_PING_ticks();
+
+/// Time since ping_timer_init() was first called.
+/**
+* Timer 1 never stops, so its overflows are counted to make a clock that wraps after about 4.7 hours.
+* @return uptime in timer 1 ticks (4 us each)
+*/
+unsigned long uptime_ticks();
+
 /// Initializes the servo.
 /** 
 * A function that initializes the ISR timer for the servo, setting the TOP value using the following equation: pulse period in cycles; (clock_frequency/(prescaler * 1000)) * pulse period. Servo degrees is calculated using the following equation: ((clock_frequency/(prescaler * 1000)) * pulse_time_in_ms) * calibration_value
@@ -61,8 +94,15 @@ void servo_timer_init();
 */
 void move_servo(volatile float* degrees);
 
+/// Sets the raw servo pulse width. Used for calibration.
+/**
+* @param pulse pulse width in OCR3B counts (0.5 us each)
+*/
+void servo_set_pulse(unsigned int pulse);
+
 /// Readies the USART for communication.
 /** 
+* Received characters are buffered by the receive interrupt, up to USART_RX_BUFFER of them.
 * @param ubrr constitutes: clock rate / (system bit / speed) / (baud rate - 1). See page 362 of User Guide for register summary.
 */
 void USART_Init(unsigned int ubrr);
@@ -76,13 +116,34 @@ void USART_Transmit(unsigned char data);
 
 /// Waits for data to be received and returns the sent character. Enabled by USART_Init.
 /**
-* Waits for data to be received before getting and returning the received data from the buffer.
+* Sleeps until data is received (see idle.h) before getting and returning the received data from the buffer.
 */
 unsigned char USART_Receive(void);
 
+/// Checks if a character has been received. Enabled by USART_Init.
+/**
+* @return 1 if USART_Receive() would return immediately, 0 otherwise
+*/
+unsigned char USART_Available(void);
+
+/// Sleeps until a character has been received or a timeout passes. Enabled by USART_Init.
+/**
+* Lets a loop that waits for the operator do other work now and then without spinning.
+* @param ms timeout in milliseconds, less than 262
+* @return 1 if USART_Receive() would return immediately, 0 if the timeout passed first
+*/
+unsigned char USART_Wait(unsigned int ms);
+
 /// Calls USART_Transmit for each character in the array. Written by Omar.
 /**
 * @param message array of character to be looped through and sent over USART until a null character is found.
 */
 void send_message(char *message);
 
+/// Calls USART_Transmit for each character of a string kept in flash.
+/**
+* Constant messages should use this with PSTR(), so they don't take up SRAM.
+* @param message string in program memory, sent until a null character is found.
+*/
+void send_message_P(const char *message);
+